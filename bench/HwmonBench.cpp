@@ -0,0 +1,106 @@
+// Compares reading a mock hwmon tree through HwmonChip (persistent descriptors,
+// one io_uring submission per chip when built with IO_URING_SUPPORT) against
+// opening, reading & closing each attribute as sensors used to
+//
+// Usage: fancon-hwmon-bench [chips] [attributes per chip] [ticks]
+
+#include <cstdlib>
+#include <iomanip>
+#include <thread>
+
+#include "sensor/HwmonChip.hpp"
+#include "util/Util.hpp"
+
+using fc::HwmonChip;
+
+namespace {
+struct Result {
+  double tick_us, read_syscalls;
+};
+
+// Read syscalls made by this process, including any io_uring doesn't replace
+long read_syscalls() {
+  std::ifstream ifs("/proc/self/io");
+  string key;
+  long value;
+  while (ifs >> key >> value) {
+    if (key == "syscr:")
+      return value;
+  }
+  return 0;
+}
+
+vector<path> mock_tree(const path &root, uint chips, uint attrs) {
+  vector<path> paths;
+  for (uint c = 0; c < chips; ++c) {
+    const path dir = root / ("hwmon" + to_string(c));
+    fs::create_directories(dir);
+    std::ofstream(dir / "update_interval") << 1 << '\n';
+
+    for (uint a = 1; a <= attrs; ++a) {
+      paths.push_back(dir / ("temp" + to_string(a) + "_input"));
+      std::ofstream(paths.back()) << 40000 + a << '\n';
+    }
+  }
+  return paths;
+}
+
+template <typename F> Result run(const vector<path> &paths, uint ticks, F read) {
+  // Untimed first tick, so descriptors are opened & registered up front
+  for (const auto &p : paths)
+    read(p);
+
+  chrono::nanoseconds total{0};
+  const long syscalls_before = read_syscalls();
+  for (uint t = 0; t < ticks; ++t) {
+    // Past the chip's update_interval, so every tick re-reads the chip
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+    const auto start = chrono::steady_clock::now();
+    for (const auto &p : paths)
+      read(p);
+    total += chrono::steady_clock::now() - start;
+  }
+  // Less the 2 reads of /proc/self/io itself
+  const long syscalls = read_syscalls() - syscalls_before - 2;
+
+  return {total.count() / 1000.0 / ticks,
+          double(syscalls) / ticks};
+}
+
+void print(const string &mode, const Result &r) {
+  std::cout << std::left << std::setw(24) << mode << std::right << std::setw(12)
+            << std::fixed << std::setprecision(1) << r.tick_us << std::setw(22)
+            << r.read_syscalls << '\n';
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const auto arg = [&](int i, uint def) {
+    return (argc > i) ? uint(std::strtoul(argv[i], nullptr, 10)) : def;
+  };
+  const uint chips = arg(1, 4), attrs = arg(2, 16), ticks = arg(3, 500);
+  fc::log::set_level(llvl::warning);
+
+  char dir_template[] = "/tmp/fancon-bench-XXXXXX";
+  if (mkdtemp(dir_template) == nullptr) {
+    std::cerr << "Failed to create mock hwmon tree: " << strerror(errno) << '\n';
+    return 1;
+  }
+  const path root(dir_template);
+  const auto paths = mock_tree(root, chips, attrs);
+
+  std::cout << chips << " chips x " << attrs << " attributes, " << ticks << " ticks\n"
+            << std::left << std::setw(24) << "mode" << std::right << std::setw(12)
+            << "us/tick" << std::setw(22) << "read syscalls/tick" << '\n';
+
+  print("open, read & close", run(paths, ticks, [](const path &p) {
+    return fc::Util::read<long>(p);
+  }));
+  print("HwmonChip", run(paths, ticks, [](const path &p) {
+    return HwmonChip::read(p);
+  }));
+
+  fs::remove_all(root);
+  return 0;
+}
@@ -0,0 +1,19 @@
+# Find URing
+# -----------
+# Find the liburing library and headers (io_uring helpers)
+#
+# liburing can be found at github.com/axboe/liburing
+#
+#   URING_INCLUDE_DIR - Path to header (liburing.h)
+#   URING_LIBRARY     - Path to library (uring)
+#   URING_FOUND       - True if both URING_INCLUDE_DIR & URING_LIBRARY are found
+
+find_path(URING_INCLUDE_DIR
+        NAMES liburing.h)
+
+find_library(URING_LIBRARY
+        NAMES uring)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(URing DEFAULT_MSG
+        URING_INCLUDE_DIR URING_LIBRARY)
@@ -1,5 +1,6 @@
 #include "Client.hpp"
 #include "Controller.hpp"
+#include "Library.hpp"
 
 fc::Client::Client() {
   //  auto creds = grpc::SslCredentials(grpc::SslCredentialsOptions());
@@ -9,7 +10,8 @@ fc::Client::Client() {
 }
 
 void fc::Client::run(Args &args) {
-  if ((args.status || args.disable || args.test || args.reload || args.stop_service || args.nv_init || args.sysinfo)
+  if ((args.status || args.disable || args.test || args.cancel || args.reload || args.profile || args.latency || args.stop_service || args.nv_init
+      || args.sysinfo || args.export_profiles || args.import_profiles)
       && !connected(1000)) {
     log_service_unavailable();
     return;
@@ -34,10 +36,16 @@ void fc::Client::run(Args &args) {
       test(args.test.value, true);
     else
       test(args.force);
+  } else if (args.cancel) {
+    cancel_test(args.cancel.value);
   } else if (args.monitor) {
     monitor(args.monitor.value);
   } else if (args.reload) {
     reload();
+  } else if (args.profile) {
+    set_profile(args.profile.value);
+  } else if (args.latency) {
+    latency_test(args.latency.value);
   } else if (args.stop_service) {
     stop_service();
   } else if (args.recover) {
@@ -46,6 +54,10 @@ void fc::Client::run(Args &args) {
     nv_init();
   } else if (args.sysinfo) {
     sysinfo(args.sysinfo.value);
+  } else if (args.export_profiles) {
+    export_profiles(args.export_profiles.value);
+  } else if (args.import_profiles) {
+    import_profiles(args.import_profiles.value);
   } else if (Util::is_atty() && !exists(args.config.value)) {
     // Offer test
     cout << log::fmt_green << "Test devices & generate a config? (y/n): " << log::fmt_reset;
@@ -152,19 +164,28 @@ void fc::Client::test(bool forced) {
     return;
   }
 
-  vector<thread> threads;
-  for (const auto &f : devices->fan()) {
-    const string &flabel = f.label();
-    threads.emplace_back([=] { test(flabel, forced); });
+  ClientContext context;
+  fc_pb::TestManyRequest req;
+  req.set_forced(forced);
+
+  // Progress of all fans is interleaved on the one stream
+  auto reader = client->TestMany(&context, req);
+  std::set<string> tested;
+  fc_pb::TestResponse resp;
+  while (reader->Read(&resp)) {
+    const string &flabel = resp.device_label();
+    tested.emplace(flabel);
+    if (resp.status() == -1)
+      LOG(llvl::error) << flabel << ": test failed";
+    else
+      LOG(llvl::info) << flabel << ": " << resp.status() << "%";
   }
 
-  if (!forced && threads.size() != devices->fan().size())
-    LOG(llvl::info) << "Add 'force' option to test already tested fans";
+  if (!check(reader->Finish()))
+    LOG(llvl::error) << "Tests failed";
 
-  for (auto &t : threads) {
-    if (t.joinable())
-      t.join();
-  }
+  if (!forced && tested.size() != static_cast<size_t>(devices->fan_size()))
+    LOG(llvl::info) << "Add 'force' option to test already tested fans";
 }
 
 void fc::Client::test(const string &flabel, bool forced) {
@@ -187,16 +208,25 @@ void fc::Client::test(const string &flabel, bool forced) {
     LOG(llvl::error) << flabel << ": test failed";
 }
 
+void fc::Client::cancel_test(const string &flabel) {
+  ClientContext context;
+  fc_pb::FanLabel l;
+  l.set_label(flabel);
+  if (check(client->CancelTest(&context, l, &empty)))
+    LOG(llvl::info) << (flabel.empty() ? "All tests" : flabel) << ": cancelled";
+}
+
 void fc::Client::monitor(const string &flabel) {
   status();
 
   ClientContext context;
-  const auto reader = client->SubscribeFanStatus(&context, empty);
+  fc_pb::SubscribeFilter filter;
+  if (!flabel.empty())
+    filter.add_label(flabel);
+
+  const auto reader = client->SubscribeFanStatus(&context, filter);
   fc_pb::FanStatus r;
   while (reader->Read(&r)) {
-    if (!flabel.empty() && flabel != r.label())
-      continue;
-
     const string pwm_rpm =
         (r.status() != fc_pb::FanStatus_Status_DISABLED) ? to_string(r.rpm()) + "rpm, " + to_string(r.pwm()) + "pwm"
                                                          : "";
@@ -214,6 +244,33 @@ void fc::Client::reload() {
     LOG(llvl::error) << "Failed to reload";
 }
 
+void fc::Client::set_profile(const string &name) {
+  ClientContext context;
+  fc_pb::ProfileName req;
+  req.set_name(name);
+  if (check(client->SetProfile(&context, req, &empty)))
+    LOG(llvl::info) << "Profile: " << (name.empty() ? "default" : name);
+}
+
+void fc::Client::latency_test(const string &seconds) {
+  const auto secs = (seconds.empty()) ? optional(10u) : Util::from_string<uint>(seconds);
+  if (!secs || milliseconds(*secs * 1000) > LATENCY_TEST_MAX_DURATION) {
+    LOG(llvl::error) << "Invalid duration: " << seconds << " (max "
+                     << LATENCY_TEST_MAX_DURATION.count() / 1000 << "s)";
+    return;
+  }
+
+  LOG(llvl::info) << "Measuring tick latency with all CPUs busy for " << *secs << "s";
+  ClientContext context;
+  fc_pb::LatencyTestRequest req;
+  req.set_duration(*secs * 1000);
+  fc_pb::LatencyTestResponse resp;
+  if (check(client->LatencyTest(&context, req, &resp))) {
+    LOG(llvl::info) << resp.ticks() << " ticks" << (resp.realtime() ? " (real-time)" : "")
+                    << ": max delay " << resp.max_delay() << "µs, mean " << resp.mean_delay() << "µs";
+  }
+}
+
 void fc::Client::recover() {
   ClientContext context;
   if (!check(client->Recover(&context, empty, &empty)))
@@ -267,6 +324,28 @@ void fc::Client::sysinfo(const string &p) {
   }
 }
 
+void fc::Client::export_profiles(const string &p) {
+  ClientContext context;
+  fc_pb::Characterizations cs;
+  if (!check(client->ExportProfiles(&context, empty, &cs)))
+    return;
+
+  if (Library::write(p, cs))
+    LOG(llvl::info) << cs.characterization_size() << " characterizations written to: " << p;
+}
+
+void fc::Client::import_profiles(const string &p) {
+  const auto cs = Library::read(p);
+  if (!cs) {
+    LOG(llvl::error) << "Failed to read: " << p;
+    return;
+  }
+
+  ClientContext context;
+  if (check(client->ImportProfiles(&context, *cs, &empty)))
+    LOG(llvl::info) << "Imported " << cs->characterization_size() << " characterizations";
+}
+
 void fc::Client::print_help(const string &conf) {
   LOG(llvl::info) << "fancon arg [value] ..." << endl << "h  help           Show this help" << endl
                   << "s  status         Status of all fans" << endl << "e  enable         Enable control of all fans"
@@ -275,15 +354,22 @@ void fc::Client::print_help(const string &conf) {
                   << "d  disable [fan]  Disable control of the fans" << endl
                   << "t  test           Test all (untested) fans" << endl << "t  test    [fan]  Test the fan (forced)"
                   << endl << "f  force          Test even already tested fans " << "(default: false)" << endl
+                  << "x  cancel         Cancel all running tests" << endl
+                  << "x  cancel  [fan]  Cancel the fan's test" << endl
                   << "m  monitor        Monitor all fans" << endl << "m  monitor [fan]  Monitor the fan" << endl
-                  << "r  reload         Reload config" << endl << "c  config  [file] Config path (default: "
+                  << "r  reload         Reload config" << endl
+                  << "p  profile [name] Switch profile (default: fan curves)" << endl
+                  << "l  latency [secs] Measure worst-case tick delay under CPU load (default: 10, max: 60)" << endl << "c  config  [file] Config path (default: "
                   << log::fmt_green_bold << conf << log::fmt_reset << ")" << endl
                   << "   service        Start as service" << endl
                   << "   daemon         Daemonize the process (default: false)" << endl
                   << "   stop-service   Stop the service" << endl
                   << "i  sysinfo [file] Save system info to file (default: " << fc::DEFAULT_SYSINFO_PATH << ")" << endl
                   << "   recover        Recover control of enabled devices" << endl
-                  << "   nv-init        Init nvidia devices" << endl << "v  verbose        Debug logging level" << endl
+                  << "   nv-init        Init nvidia devices" << endl
+                  << "   export-profiles [file] Export test results for identical hardware (default: "
+                  << fc::DEFAULT_PROFILES_PATH << ")" << endl
+                  << "   import-profiles [file] Import test results, untested matching fans use them" << endl << "v  verbose        Debug logging level" << endl
                   << "a  trace          Trace logging level" << endl;
 }
 
@@ -34,11 +34,16 @@ public:
   void disable(const string &flabel);
   void test(bool forced);
   void test(const string &flabel, bool forced);
+  void cancel_test(const string &flabel);
   void monitor(const string &flabel);
   void reload();
+  void set_profile(const string &name);
+  void latency_test(const string &seconds);
   void recover();
   void nv_init();
   void sysinfo(const string &p);
+  void export_profiles(const string &p);
+  void import_profiles(const string &p);
 
   static void print_help(const string &conf);
   static bool service_running();
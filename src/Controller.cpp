@@ -6,14 +6,41 @@ bool dynamic = true;
 uint smoothing_intervals = 4;
 uint top_stickiness_intervals = 4;
 uint temp_averaging_intervals = 8;
+bool thermal_events = false;
+milliseconds baseline_interval(5000);
+uint attack_intervals = 0;
+uint release_intervals = 0;
+Temp emergency_margin = 5;
+bool adaptive_interval = false;
+milliseconds min_interval(250);
+milliseconds max_interval(4000);
+double fast_temp_rate = 1.0;
+uint timer_slack = 0;
+uint rt_priority = 0;
+uint rt_cpu = 0;
+bool recalibrate = false;
+uint recalibrate_threshold = 10;
+bool spot_check = false;
 } // namespace fc
 
-fc::Controller::Controller(path conf_path_) : config_path(move(conf_path_)) {
+fc::Controller::Controller(path conf_path_)
+    : config_path(move(conf_path_)),
+      library(path(config_path).replace_extension("library")),
+      enumeration(make_unique<Enumeration>()) {
   reload(true);
   watcher = spawn_watcher();
+  enumeration->watch([this] { reload(); });
 }
 
-fc::Controller::~Controller() { disable_all(); }
+fc::Controller::~Controller() {
+  // Stop hotplug events first, so they don't reload while shutting down
+  enumeration.reset();
+  disable_all();
+
+  // Flush a pending write
+  if (pending_save.valid())
+    pending_save.wait();
+}
 
 FanStatus fc::Controller::status(const string &flabel) {
   const auto lock = lock_task_read(flabel);
@@ -36,9 +63,15 @@ void fc::Controller::enable(fc::Fan &f, bool enable_all_dell) {
 
   tasks.emplace(f.label, [this, &f](bool &run) {
     LOG(llvl::trace) << f.label << ": enabled";
+    // Slack is per thread; allows the kernel to coalesce our wakeups
+    if (prctl(PR_SET_TIMERSLACK, ulong(timer_slack) * 1000) != 0)
+      LOG(llvl::warning) << f.label << ": failed to set timer slack";
+    enter_realtime(f.label);
+
     while (run) {
       notify_status_observers(f.label);
-      f.update();
+      if (f.update()) // Recalibrated
+        save();
     }
 
     f.disable_control();
@@ -53,11 +86,14 @@ void fc::Controller::enable_all() {
 
 void fc::Controller::disable(const string &flabel, bool disable_all_dell) {
   {
-    const auto lock = lock_task_write(flabel);
-    if (!tasks.contains(flabel))
+    // Destroyed outside the lock, as a cancelled test takes it to finish
+    decltype(tasks)::node_type task;
+    {
+      const auto lock = lock_task_write(flabel);
+      task = tasks.extract(flabel);
+    }
+    if (task.empty())
       return;
-
-    tasks.erase(flabel);
   }
   if (const auto fit = devices.fans.find(flabel); fit != devices.fans.end()) {
     fit->second->disable_control();
@@ -84,72 +120,148 @@ void fc::Controller::disable_all() {
 }
 
 void fc::Controller::reload(bool just_started) {
+  // Hotplug, the config watcher & gRPC may all reload at once
+  const lock_guard<mutex> devices_lg(devices_mutex);
   if (!just_started)
     LOG(llvl::info) << "Reloading";
 
-  Devices enumerated(true);
+  Devices enumerated(enumeration->devices());
   merge(enumerated, false);
 
   if (const auto c = read_config(); c) {
     from(c->config());
+    profiles.assign(c->profile().begin(), c->profile().end());
 
     Devices conf_devs(c->devices());
     merge(conf_devs, true, true);
 
     remove_devices_not_in({{enumerated}, {conf_devs}});
+    devices.zones = move(conf_devs.zones);
   } else {
     remove_devices_not_in({{enumerated}});
+    devices.zones.clear();
   }
 
+  devices.link_sensors();
+  devices.link_zones();
+  listen_thermal_events();
+  lock_memory();
+
+  apply_profiles();
   notify_devices_observers();
 }
 
+void fc::Controller::listen_thermal_events() {
+  thermal_listener.reset();
+  if (!thermal_events)
+    return;
+
+  // Alarms are per chip, so watch each hwmon dir with a sysfs sensor
+  std::set<path> hwmon_dirs;
+  for (const auto &[label, s] : devices.sensors) {
+    if (s->type() != DevType::SYS)
+      continue;
+
+    fc_pb::Sensor pb;
+    s->to(pb);
+    hwmon_dirs.insert(path(pb.input_path()).parent_path());
+  }
+
+  thermal_listener = make_unique<ThermalEvents>(hwmon_dirs);
+  if (!ThermalEvents::listening())
+    LOG(llvl::warning) << "No thermal event sources; updating every "
+                       << update_interval.count() << "ms";
+}
+
+void fc::Controller::lock_memory() {
+  // Keep pages resident in real-time mode, so ticks never wait on page faults
+  if (rt_priority == 0) {
+    munlockall();
+  } else if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    LOG(llvl::warning) << "Failed to lock memory: " << strerror(errno);
+  }
+}
+
+void fc::Controller::enter_realtime(const string &thread_label) {
+  // Only control threads are real-time; gRPC & logging keep normal priority
+  if (rt_priority == 0)
+    return;
+
+  if (!Util::set_realtime(rt_priority, rt_cpu))
+    LOG(llvl::warning) << thread_label << ": failed to enter real-time mode";
+  Util::prefault_stack();
+}
+
+fc::LatencyStats fc::Controller::latency_test(milliseconds duration) {
+  duration = std::min(duration, LATENCY_TEST_MAX_DURATION);
+
+  // Saturate every CPU at normal priority, as compute jobs would
+  std::atomic_bool hogging = true;
+  vector<std::thread> hogs;
+  for (uint i = 0; i < std::thread::hardware_concurrency(); ++i) {
+    hogs.emplace_back([&] {
+      while (hogging.load(std::memory_order_relaxed)) {
+      }
+    });
+  }
+
+  // Tick like a fan thread, recording how late each wakeup is
+  LatencyStats stats;
+  std::thread([&] {
+    enter_realtime("latency test");
+    const long period_ns = LATENCY_TEST_PERIOD.count() * 1'000'000L;
+    const long end = Util::monotonic_ns() + duration.count() * 1'000'000L;
+    long total_ns = 0;
+    for (long deadline = Util::monotonic_ns() + period_ns; deadline < end;
+         deadline += period_ns) {
+      const long late_ns = Util::sleep_until(deadline);
+      stats.max = std::max(stats.max, chrono::microseconds(late_ns / 1000));
+      total_ns += late_ns;
+      ++stats.ticks;
+    }
+
+    if (stats.ticks > 0)
+      stats.mean = chrono::microseconds(total_ns / stats.ticks / 1000);
+  }).join();
+
+  hogging = false;
+  for (auto &t : hogs)
+    t.join();
+
+  LOG(llvl::info) << "Latency test: " << stats.ticks << " ticks, max "
+                  << stats.max.count() << "µs, mean " << stats.mean.count() << "µs";
+  return stats;
+}
+
 void fc::Controller::recover() {
   // Re-enable control for all running tasks
   for (const auto &[flabel, t] : tasks) {
     const auto lock = lock_task_read(flabel);
     const auto it = devices.fans.find(flabel);
-    if (it != devices.fans.end())
+    if (it != devices.fans.end()) {
       it->second->enable_control();
+      it->second->invalidate();
+    }
   }
 }
 
 void fc::Controller::nv_init() {
 #ifdef FANCON_NVIDIA_SUPPORT
-  if (NV::init(true))
+  if (NV::init(true)) {
+    enumeration->rescan_nvidia();
     reload();
+  }
 #endif // FANCON_NVIDIA_SUPPORT
 }
 
-void fc::Controller::test(fc::Fan &fan, bool forced, bool blocking,
+fc_pb::Devices fc::Controller::enumerated_devices() {
+  return enumeration->devices();
+}
+
+bool fc::Controller::test(fc::Fan &fan, bool forced, bool blocking,
                           shared_ptr<Util::ObservableNumber<int>> test_status) {
   if (fan.ignore || (fan.tested() && !forced))
-    return;
-
-  auto test_func = [&] {
-    LOG(llvl::info) << fan << ": testing";
-    const bool success = fan.test(*test_status);
-
-    // Test has completed
-    LOG(llvl::info) << fan << ": test " << (success ? "complete" : "failed");
-    {
-      const auto lock = lock_task_read(fan.label);
-      tasks.find(fan.label)->second.test_status.reset();
-    }
-
-    // Only write to file when no other fan are still testing
-    if (tests_running() == 0)
-      to_file(false);
-
-    // Remove the test thread we're on, and start another enable thread
-    thread([&] {
-      {
-        const auto lock = lock_task_write(fan.label);
-        tasks.erase(fan.label);
-      }
-      enable(fan);
-    }).detach();
-  };
+    return false;
 
   // If a test is already running for the device then just join onto it
   {
@@ -161,18 +273,26 @@ void fc::Controller::test(fc::Fan &fan, bool forced, bool blocking,
         it->second.test_status->register_observer(cb, true);
       if (blocking)
         it->second.join();
-      return;
+      return true;
     }
 
     // Remove any running thread before testing
     tasks.erase(fan.label);
 
+    // Claimed by whichever comes first; the test finishing, or its removal
+    // cancelling it
+    auto finished = make_shared<std::atomic_bool>(false);
+    const auto cancel = [&fan, finished] {
+      if (!finished->exchange(true))
+        fan.cancel_test();
+    };
     const auto &[it, success] = tasks.emplace(
         std::piecewise_construct, std::forward_as_tuple(fan.label),
-        std::forward_as_tuple(move(test_func), test_status));
+        std::forward_as_tuple(run_test(fan, forced, test_status, finished),
+                              test_status, cancel));
     if (!success) {
       LOG(llvl::error) << "Failed to start test - " << fan.label;
-      return;
+      return false;
     }
   }
 
@@ -181,6 +301,81 @@ void fc::Controller::test(fc::Fan &fan, bool forced, bool blocking,
   const auto lock = lock_task_read(fan.label);
   if (auto it = tasks.find(fan.label); blocking && it != tasks.end())
     it->second.join();
+
+  return true;
+}
+
+fc::Task<> fc::Controller::run_test(fc::Fan &fan, bool forced,
+                                    shared_ptr<Util::ObservableNumber<int>> test_status,
+                                    shared_ptr<std::atomic_bool> finished) {
+  // Identical hardware has already been tested, unless forced to retest
+  const auto c = (forced) ? nullopt : library.find(fan.fingerprint());
+  bool success = c && co_await fan.use_characterization(*c, spot_check, *test_status);
+
+  if (!success) {
+    LOG(llvl::info) << fan << ": testing";
+    success = co_await fan.test(*test_status, [this] { save(); });
+    if (success) {
+      fc_pb::Characterization result;
+      fan.characterization_to(result);
+      library.add(result);
+      save();
+    }
+  }
+
+  // Test has completed
+  LOG(llvl::info) << fan << ": test " << (success ? "complete" : "failed");
+
+  // Removed while testing; control is left to whatever removed it, and the
+  // completed phases stay checkpointed to resume from
+  if (finished->exchange(true))
+    co_return;
+
+  {
+    const auto lock = lock_task_read(fan.label);
+    if (const auto it = tasks.find(fan.label); it != tasks.end())
+      it->second.test_status.reset();
+  }
+
+  // Parallel tests finishing together are coalesced into one write
+  save();
+
+  // Remove the test task we're on (waits for it to finish), and start another
+  // enable thread; unless it was disabled meanwhile, which removed it already
+  thread([this, &fan, flabel = fan.label] {
+    {
+      const auto lock = lock_task_write(flabel);
+      if (tasks.erase(flabel) == 0)
+        return;
+    }
+    enable(fan);
+  }).detach();
+}
+
+bool fc::Controller::cancel_test(const string &flabel) {
+  const auto it = devices.fans.find(flabel);
+  if (it == devices.fans.end() || !is_testing(flabel))
+    return false;
+
+  it->second->cancel_test();
+  LOG(llvl::info) << flabel << ": cancelling test";
+  return true;
+}
+
+void fc::Controller::export_characterizations(fc_pb::Characterizations &cs) const {
+  library.to(cs);
+}
+
+void fc::Controller::import_characterizations(const fc_pb::Characterizations &cs) {
+  library.merge(cs);
+  save();
+  LOG(llvl::info) << "Imported " << cs.characterization_size() << " characterizations";
+
+  // Untested fans with a match can now skip their test
+  for (const auto &[flabel, f] : devices.fans) {
+    if (!f->ignore && !f->tested() && library.find(f->fingerprint()))
+      test(*f, false, false, make_shared<Util::ObservableNumber<int>>(0));
+  }
 }
 
 size_t fc::Controller::tests_running() {
@@ -192,18 +387,109 @@ size_t fc::Controller::tests_running() {
 }
 
 void fc::Controller::set_devices(const fc_pb::Devices &devices_) {
+  const lock_guard<mutex> devices_lg(devices_mutex);
   disable_all();
   devices = fc::Devices(false);
   devices.from(devices_);
-  to_file(false);
+  apply_profiles();
+  save();
   enable_all();
 }
 
+void fc::Controller::patch_devices(const fc_pb::DevicesPatch &patch) {
+  const lock_guard<mutex> devices_lg(devices_mutex);
+  // Sensors first so patched fans find their patched sensor
+  for (const auto &sp : patch.sensor()) {
+    const auto it = devices.sensors.find(sp.sensor().label());
+    if (it == devices.sensors.end())
+      continue;
+
+    fc_pb::Sensor s;
+    it->second->to(s);
+    Util::merge(sp.sensor(), sp.mask(), s);
+    it->second->patch(s);
+  }
+  if (patch.sensor_size() > 0)
+    devices.link_sensors();
+
+  for (const auto &fp : patch.fan()) {
+    const auto it = devices.fans.find(fp.fan().label());
+    if (it == devices.fans.end())
+      continue;
+
+    Fan &fan = *it->second;
+    fc_pb::Fan f;
+    fan.to(f);
+    Util::merge(fp.fan(), fp.mask(), f);
+
+    const bool previously_configured = fan.is_configured(false);
+    fan.patch(f, devices.sensors);
+    fan.compile_profiles(profiles);
+    fan.use_profile(active_profile);
+
+    // Only start or stop control when the patch changed if it's configured
+    const FanStatus fstatus = status(fan.label);
+    if (fstatus == FanStatus::FanStatus_Status_ENABLED &&
+        !fan.is_configured(true)) {
+      disable(fan.label);
+    } else if (fstatus == FanStatus::FanStatus_Status_DISABLED &&
+               !previously_configured && fan.is_configured(false)) {
+      enable(fan);
+    }
+  }
+
+  // Patches may change paths, and so hw_ids
+  devices.index();
+
+  // Written once for the whole patch
+  save();
+}
+
+bool fc::Controller::set_profile(const string &name) {
+  const lock_guard<mutex> devices_lg(devices_mutex);
+  const bool exists = std::any_of(profiles.begin(), profiles.end(),
+                                  [&](const auto &p) { return p.name() == name; });
+  if (!name.empty() && !exists)
+    return false;
+
+  // Profiles are pre-compiled, fans & zones only swap to their curve
+  for (const auto &[flabel, f] : devices.fans)
+    f->use_profile(name);
+  for (const auto &[zlabel, z] : devices.zones)
+    z->use_profile(name);
+
+  active_profile = name;
+  LOG(llvl::info) << "Profile: " << (name.empty() ? "default" : name);
+  save();
+  return true;
+}
+
 void fc::Controller::from(const fc_pb::ControllerConfig &c) {
+  active_profile = c.profile();
   dynamic = c.dynamic();
   smoothing_intervals = c.smoothing_intervals();
   top_stickiness_intervals = c.top_stickiness_intervals();
   temp_averaging_intervals = c.temp_averaging_intervals();
+  attack_intervals = c.attack_intervals();
+  release_intervals = c.release_intervals();
+  emergency_margin = c.emergency_margin();
+  adaptive_interval = c.adaptive_interval();
+  if (c.min_interval() > 0)
+    min_interval = milliseconds(c.min_interval());
+  if (c.max_interval() > 0)
+    max_interval = milliseconds(c.max_interval());
+  if (c.fast_temp_rate() > 0)
+    fast_temp_rate = c.fast_temp_rate();
+  timer_slack = c.timer_slack();
+  rt_priority = std::min(c.rt_priority(), 99u);
+  rt_cpu = c.rt_cpu();
+  spot_check = c.spot_check();
+  recalibrate = c.recalibrate();
+  if (c.recalibrate_threshold() > 0)
+    recalibrate_threshold = c.recalibrate_threshold();
+  thermal_events = c.thermal_events();
+  if (c.baseline_interval() > 0)
+    baseline_interval = milliseconds(c.baseline_interval());
 
   if (c.update_interval() > 0) {
     update_interval = milliseconds(c.update_interval());
@@ -215,6 +501,8 @@ void fc::Controller::from(const fc_pb::ControllerConfig &c) {
 void fc::Controller::to(fc_pb::Controller &c) const {
   to(*c.mutable_config());
   devices.to(*c.mutable_devices());
+  for (const auto &p : profiles)
+    *c.add_profile() = p;
 }
 
 void fc::Controller::to(fc_pb::ControllerConfig &c) const {
@@ -223,6 +511,22 @@ void fc::Controller::to(fc_pb::ControllerConfig &c) const {
   c.set_smoothing_intervals(smoothing_intervals);
   c.set_top_stickiness_intervals(top_stickiness_intervals);
   c.set_temp_averaging_intervals(temp_averaging_intervals);
+  c.set_profile(active_profile);
+  c.set_attack_intervals(attack_intervals);
+  c.set_release_intervals(release_intervals);
+  c.set_emergency_margin(emergency_margin);
+  c.set_adaptive_interval(adaptive_interval);
+  c.set_min_interval(min_interval.count());
+  c.set_max_interval(max_interval.count());
+  c.set_fast_temp_rate(fast_temp_rate);
+  c.set_timer_slack(timer_slack);
+  c.set_rt_priority(rt_priority);
+  c.set_rt_cpu(rt_cpu);
+  c.set_spot_check(spot_check);
+  c.set_recalibrate(recalibrate);
+  c.set_recalibrate_threshold(recalibrate_threshold);
+  c.set_thermal_events(thermal_events);
+  c.set_baseline_interval(baseline_interval.count());
 }
 
 void fc::Controller::enable_dell_fans(
@@ -269,21 +573,22 @@ optional<fc_pb::Controller> fc::Controller::read_config() {
 }
 
 void fc::Controller::merge(Devices &d, bool replace_on_match, bool deep_cmp) {
-  const auto m = [&](auto &src, auto &dst, const auto &on_match) {
+  const auto m = [&](auto &src, auto &dst, auto &dst_ids, const auto &on_match) {
     for (auto &[key, dev] : src) {
       // Insert or assign or overwrite any existing device sharing that hw_id
       const string hw_id = dev->hw_id();
-      auto it = find_if(dst.begin(), dst.end(), [&](const auto &p) {
-        return p.second->hw_id() == hw_id;
-      });
-
-      const bool match = it != dst.end();
-      if (match) {
-        if (replace_on_match && (!deep_cmp || !dev->deep_equal(*it->second))) {
-          on_match(it, it->first, key, dev);
-        }
-      } else {
-        dst.emplace(key, move(dev));
+      auto id_it = dst_ids.find(hw_id);
+      auto it = (id_it != dst_ids.end()) ? dst.find(id_it->second) : dst.end();
+      if (it == dst.end()) {
+        if (dst.emplace(key, move(dev)).second)
+          dst_ids.insert_or_assign(hw_id, key);
+        continue;
+      }
+
+      if (replace_on_match && (!deep_cmp || !dev->deep_equal(*it->second))) {
+        on_match(it, it->first, key, dev);
+        if (dst.contains(key)) // Re-inserted under the new key
+          id_it->second = key;
       }
     }
   };
@@ -296,7 +601,7 @@ void fc::Controller::merge(Devices &d, bool replace_on_match, bool deep_cmp) {
     dell_fan_enabled |= fan.type() == fc_pb::DELL;
   };
 
-  m(d.fans, devices.fans,
+  m(d.fans, devices.fans, devices.fan_ids,
     [&](auto &old_it, const string &old_key, const string &new_key, auto &dev) {
       // On match; re-insert device as the key may have changed
       const auto re_insert = [&] {
@@ -319,6 +624,7 @@ void fc::Controller::merge(Devices &d, bool replace_on_match, bool deep_cmp) {
       } else if (fstatus == FanStatus::FanStatus_Status_TESTING) {
         const auto test_status = tasks.find(old_key)->second.test_status;
         disable(old_key, false);
+        dev->resume_test_from(*old_it->second);
         auto [it, success] = re_insert();
         test(*it->second, true, false, test_status);
 
@@ -330,7 +636,7 @@ void fc::Controller::merge(Devices &d, bool replace_on_match, bool deep_cmp) {
   if (dell_fan_enabled)
     enable_dell_fans();
 
-  m(d.sensors, devices.sensors,
+  m(d.sensors, devices.sensors, devices.sensor_ids,
     [&](auto &old_it, [[maybe_unused]] const string &old_key,
         const string &new_key, auto &dev) {
       // On match; re-insert device as the key may have changed
@@ -339,58 +645,116 @@ void fc::Controller::merge(Devices &d, bool replace_on_match, bool deep_cmp) {
     });
 }
 
+void fc::Controller::apply_profiles() {
+  if (!active_profile.empty() &&
+      std::none_of(profiles.begin(), profiles.end(), [&](const auto &p) {
+        return p.name() == active_profile;
+      })) {
+    LOG(llvl::warning) << "Profile '" << active_profile
+                       << "' not found; using default";
+    active_profile.clear();
+  }
+
+  for (const auto &[flabel, f] : devices.fans) {
+    f->compile_profiles(profiles);
+    f->use_profile(active_profile);
+  }
+
+  for (const auto &[zlabel, z] : devices.zones) {
+    z->compile_profiles(profiles);
+    z->use_profile(active_profile);
+  }
+}
+
 void fc::Controller::remove_devices_not_in(
     std::initializer_list<std::reference_wrapper<Devices>> l) {
   // Remove items not in conf_devs or enumerated but in devices
-  for (const auto &p : devices.fans) {
-    const auto &flabel = std::get<0>(p);
-    if (!std::any_of(l.begin(), l.end(), [&](const Devices &l) {
-          return l.fans.contains(flabel);
-        })) {
-      disable(flabel);
-      devices.fans.erase(flabel);
-    }
+  std::unordered_set<string> fan_labels, sensor_labels;
+  for (const Devices &d : l) {
+    for (const auto &[flabel, f] : d.fans)
+      fan_labels.insert(flabel);
+    for (const auto &[slabel, s] : d.sensors)
+      sensor_labels.insert(slabel);
   }
 
-  for (const auto &p : devices.sensors) {
-    const auto &slabel = std::get<0>(p);
-    if (!std::any_of(l.begin(), l.end(), [&](const Devices &l) {
-          return l.sensors.contains(slabel);
-        })) {
-      devices.sensors.erase(slabel);
+  // Collected first, as disabling & erasing would invalidate the iteration
+  vector<string> stale_fans;
+  for (const auto &[flabel, f] : devices.fans) {
+    if (!fan_labels.contains(flabel))
+      stale_fans.push_back(flabel);
+  }
+  for (const auto &flabel : stale_fans) {
+    disable(flabel);
+    if (const auto it = devices.fans.find(flabel); it != devices.fans.end()) {
+      devices.fan_ids.erase(it->second->hw_id());
+      devices.fans.erase(it);
     }
   }
+
+  std::erase_if(devices.sensors, [&](const auto &p) {
+    const bool stale = !sensor_labels.contains(p.first);
+    if (stale)
+      devices.sensor_ids.erase(p.second->hw_id());
+    return stale;
+  });
 }
 
 void fc::Controller::to_file(bool backup) {
-  // Backup existing file
-  const lock_guard<mutex> config_lg(config_mutex);
-  if (backup && exists(config_path)) {
-    const path backup_path = config_path.string() + "-" + date_time_now();
-    fs::rename(config_path, backup_path);
-    LOG(llvl::info) << "Moved previous config to: " << backup_path;
-  }
-
+  // Snapshot under devices_mutex, as reloads & patches replace devices; taken
+  // before config_mutex, in the same order as reload
   fc_pb::Controller c;
-  to(c);
+  {
+    const lock_guard<mutex> devices_lg(devices_mutex);
+    to(c);
+  }
 
   string out_s;
   google::protobuf::TextFormat::Printer printer;
   printer.SetUseShortRepeatedPrimitives(true);
   printer.PrintToString(c, &out_s);
 
-  std::ofstream ofs;
-  ofs.exceptions();
-  try {
-    ofs.open(config_path);
-    ofs << out_s;
+  {
+    // Backup existing file
+    const lock_guard<mutex> config_lg(config_mutex);
+    if (backup && exists(config_path)) {
+      const path backup_path = config_path.string() + "-" + date_time_now();
+      fs::rename(config_path, backup_path);
+      LOG(llvl::info) << "Moved previous config to: " << backup_path;
+    }
+
+    if (!Util::write_atomic(config_path, out_s)) {
+      LOG(llvl::error) << "Failed to write config: " << config_path << " - "
+                       << strerror(errno);
+      return;
+    }
+
+    // Under config_mutex, so the watcher doesn't reload our own write
     update_config_write_time();
+  }
+
+  {
+    const lock_guard<mutex> devices_lg(devices_mutex);
     notify_devices_observers();
-    LOG(llvl::info) << "Config written to: " << config_path;
-  } catch (std::ios_base::failure &e) {
-    LOG(llvl::error) << "Failed to write config: " << e.code() << " - "
-                     << e.what();
   }
+  LOG(llvl::info) << "Config written to: " << config_path;
+}
+
+void fc::Controller::save() {
+  // Coalesce bursts of changes within PERSIST_DEBOUNCE into one write
+  const lock_guard<mutex> lg(save_mutex);
+  if (!std::exchange(save_pending, true))
+    pending_save = Executor::spawn(persist());
+}
+
+fc::Task<> fc::Controller::persist() {
+  co_await Executor::sleep(PERSIST_DEBOUNCE);
+  {
+    // Changes from here on schedule another write
+    const lock_guard<mutex> lg(save_mutex);
+    save_pending = false;
+  }
+  to_file(false);
+  library.to_file();
 }
 
 void fc::Controller::update_config_write_time() {
@@ -410,11 +774,14 @@ thread fc::Controller::spawn_watcher() {
     update_config_write_time();
 
     for (; true; sleep_for(update_interval)) {
-      const lock_guard<mutex> config_lg(config_mutex);
-      if (config_file_modified()) {
+      {
+        const lock_guard<mutex> config_lg(config_mutex);
+        if (!config_file_modified())
+          continue;
         update_config_write_time();
-        reload();
       }
+      // Outside config_mutex, as reload reads the config under it
+      reload();
     }
   });
 }
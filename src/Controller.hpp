@@ -2,7 +2,10 @@
 #define FANCON_CONTROLLER_HPP
 
 #include "Devices.hpp"
+#include "Enumeration.hpp"
+#include "Library.hpp"
 #include "fan/FanTask.hpp"
+#include "sensor/ThermalEvents.hpp"
 #include "util/Util.hpp"
 #include "proto/DevicesSpec.pb.h"
 #include <algorithm>
@@ -14,11 +17,15 @@
 #include <map>
 #include <shared_mutex>
 #include <sstream>
+#include <sys/mman.h>
+#include <sys/prctl.h>
 #include <thread>
+#include <unordered_set>
 #include <utility>
 
 using fc::Fan;
 using fc::FanTask;
+using fc::ThermalEvents;
 using std::find_if;
 using std::future;
 using std::istringstream;
@@ -38,6 +45,30 @@ extern bool dynamic;
 extern uint smoothing_intervals;
 extern uint top_stickiness_intervals;
 extern uint temp_averaging_intervals;
+extern uint attack_intervals;
+extern uint release_intervals;
+extern Temp emergency_margin;
+extern bool adaptive_interval;
+extern milliseconds min_interval;
+extern milliseconds max_interval;
+extern double fast_temp_rate;
+extern uint timer_slack;
+extern uint rt_priority;
+extern uint rt_cpu;
+extern bool recalibrate;
+extern uint recalibrate_threshold;
+extern bool spot_check;
+extern bool thermal_events;
+extern milliseconds baseline_interval;
+
+const milliseconds LATENCY_TEST_PERIOD(10);
+const milliseconds LATENCY_TEST_MAX_DURATION(60000);
+const milliseconds PERSIST_DEBOUNCE(1000);
+
+struct LatencyStats {
+  uint ticks = 0;
+  chrono::microseconds max{0}, mean{0};
+};
 
 class Controller {
 public:
@@ -47,7 +78,7 @@ public:
   Devices devices;
   map<string, FanTask> tasks;
   map<string, tasks_mutex_t> tasks_mutex;
-  mutex test_mutex, config_mutex;
+  mutex test_mutex, config_mutex, devices_mutex;
   list<DevicesCallback> device_observers;
   list<StatusCallback> status_observers;
   Util::RemovableMutex device_observers_mutex, status_observers_mutex;
@@ -60,10 +91,17 @@ public:
   void reload(bool just_started = false);
   void recover();
   void nv_init();
-  void test(fc::Fan &fan, bool forced, bool blocking,
+  fc_pb::Devices enumerated_devices();
+  bool test(fc::Fan &fan, bool forced, bool blocking,
             shared_ptr<Util::ObservableNumber<int>> test_status);
+  bool cancel_test(const string &flabel);
+  void export_characterizations(fc_pb::Characterizations &cs) const;
+  void import_characterizations(const fc_pb::Characterizations &cs);
   size_t tests_running();
   void set_devices(const fc_pb::Devices &devices_);
+  void patch_devices(const fc_pb::DevicesPatch &patch);
+  bool set_profile(const string &name);
+  LatencyStats latency_test(milliseconds duration);
 
   void from(const fc_pb::ControllerConfig &c);
   void to(fc_pb::Controller &c) const;
@@ -71,19 +109,36 @@ public:
 
 private:
   path config_path;
+  Library library;
+  unique_ptr<Enumeration> enumeration;
+  vector<fc_pb::Profile> profiles;
+  string active_profile;
   optional<thread> watcher;
+  unique_ptr<ThermalEvents> thermal_listener;
   fs::file_time_type config_write_time;
+  mutex save_mutex;
+  bool save_pending = false;
+  std::shared_future<void> pending_save;
 
   void
   enable_dell_fans(const optional<const string_view> except_flabel = nullopt);
   void
   disable_dell_fans(const optional<const string_view> except_flabel = nullopt);
   bool is_testing(const string &flabel);
+  Task<> run_test(fc::Fan &fan, bool forced,
+                  shared_ptr<Util::ObservableNumber<int>> test_status,
+                  shared_ptr<std::atomic_bool> finished);
   optional<fc_pb::Controller> read_config();
   void merge(Devices &old_it, bool replace_on_match, bool deep_cmp = false);
+  void apply_profiles();
+  void listen_thermal_events();
+  void lock_memory();
+  void enter_realtime(const string &thread_label);
   void remove_devices_not_in(
       std::initializer_list<std::reference_wrapper<Devices>> list_of_devices);
   void to_file(bool backup);
+  void save();
+  Task<> persist();
   void update_config_write_time();
   bool config_file_modified();
   thread spawn_watcher();
@@ -1,71 +1,182 @@
 #include "Devices.hpp"
 
-fc::SensorChips::SensorChips() {
-  sensors_init(nullptr);
+namespace {
+const char *HWMON_CLASS_DIR = "/sys/class/hwmon";
+}
+
+#ifdef FANCON_SENSORS_SUPPORT
+mutex fc::HwmonScanner::config_mutex;
+shared_ptr<const fc::HwmonScanner::ConfigLabels> fc::HwmonScanner::parsed_config;
+#endif // FANCON_SENSORS_SUPPORT
+
+fc::HwmonScanner::HwmonScanner() {
+#ifdef FANCON_SENSORS_SUPPORT
+  // Parsed once & shared by later scans, until the config changes or a chip
+  // appears that libsensors hasn't detected
+  auto times = config_times();
+  const auto present = chips();
 
-  const sensors_chip_name *cn;
-  for (int i = 0; (cn = sensors_get_detected_chips(nullptr, &i)) != nullptr;)
-    chips.push_back(cn);
+  const lock_guard<mutex> lg(config_mutex);
+  if (!parsed_config || parsed_config->config_times != times ||
+      !std::all_of(present.begin(), present.end(),
+                   [&](const string &c) { return parsed_config->chips.contains(c); }))
+    parsed_config = parse_config(move(times), present);
+  config = parsed_config;
+#endif // FANCON_SENSORS_SUPPORT
 }
 
-fc::SensorChips::~SensorChips() { sensors_cleanup(); }
+vector<string> fc::HwmonScanner::chips() {
+  const int class_fd = open(HWMON_CLASS_DIR, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (class_fd < 0) {
+    LOG(llvl::error) << HWMON_CLASS_DIR << ": failed to open";
+    return {};
+  }
 
-void fc::SensorChips::enumerate(FanMap &fans, SensorMap &sensors) {
-  for (const auto &sc : chips) {
-    const path adapter_path(sc->path);
+  auto names = Util::list_dir(class_fd);
+  close(class_fd);
+  return names;
+}
 
-    const int buf_size = 200;
-    char buf[buf_size];
-    const string_view chip_name = (sensors_snprintf_chip_name(buf, buf_size, sc) > 0) ? buf : "";
-    const bool is_dell = SMM::is_smm_dell(chip_name);
+void fc::HwmonScanner::enumerate(FanMap &fans, SensorMap &sensors) const {
+  for (const string &chip : chips())
+    enumerate(chip, fans, sensors);
+}
 
-    const sensors_feature *sf;
-    for (int fnum = 0; (sf = sensors_get_features(sc, &fnum)) != nullptr;) {
-      const char *dev_name = sf->name, *dev_label = sensors_get_label(sc, sf);
-      string label = adapter_path.filename().string() + "/" + ((dev_label) ? dev_label : dev_name);
+void fc::HwmonScanner::enumerate(const string &chip, FanMap &fans, SensorMap &sensors) const {
+  const path chip_path = path(HWMON_CLASS_DIR) / chip;
+  const int chip_fd = open(chip_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (chip_fd < 0)
+    return;
 
-      // Only enumerate fans & sensors
-      const bool is_fan = sf->type == SENSORS_FEATURE_FAN, is_sensor = sf->type == SENSORS_FEATURE_TEMP;
-      if (!is_fan && !is_sensor)
-        continue;
+  enumerate_chip(chip_fd, chip_path, fans, sensors);
+  close(chip_fd);
+}
 
-      // Check subfeature is readable & compute mapping
-      const auto input_ssf = (is_fan) ? SENSORS_SUBFEATURE_FAN_INPUT : SENSORS_SUBFEATURE_TEMP_INPUT;
-      const sensors_subfeature *ssf = sensors_get_subfeature(sc, sf, input_ssf);
-      const bool readable = ssf != nullptr && (ssf->flags & SENSORS_MODE_R) == SENSORS_MODE_R,
-          compute_mapping = ssf != nullptr && (ssf->flags & SENSORS_COMPUTE_MAPPING) == SENSORS_COMPUTE_MAPPING;
+void fc::HwmonScanner::enumerate_chip(int chip_fd, path chip_path, FanMap &fans, SensorMap &sensors) const {
+  vector<string> names = Util::list_dir(chip_fd);
 
-      if (!readable || !compute_mapping) {
-        LOG(llvl::debug) << label << ": unable to read from device";
-        continue;
+  // Older drivers expose their attributes on the parent device, not the hwmon class device
+  int attr_fd = chip_fd;
+  if (std::find(names.begin(), names.end(), "name") == names.end()) {
+    const auto device_path = Util::real_path(chip_path / "device");
+    if (!device_path || (attr_fd = openat(chip_fd, "device", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+      return;
+
+    chip_path = *device_path;
+    names = Util::list_dir(attr_fd);
+  }
+
+  // Resolve the chip once; its attributes are regular files so their paths follow directly
+  const Util::DirEntries chip{Util::real_path(chip_path).value_or(chip_path),
+                              std::set<string>(make_move_iterator(names.begin()), make_move_iterator(names.end()))};
+  const bool is_dell = SMM::is_smm_dell(Util::read_line_at(attr_fd, "name").value_or(""));
+
+  const string_view input_postfix = "_input";
+  for (const string &attr : chip.names) {
+    // Each fan & sensor has an input attribute, e.g. fan1_input, temp2_input
+    if (!attr.ends_with(input_postfix))
+      continue;
+
+    const string feature = attr.substr(0, attr.size() - input_postfix.size());
+    const bool is_fan = feature.starts_with("fan"), is_sensor = feature.starts_with("temp");
+    const auto id = Util::postfix_num<uint>(feature);
+    if ((!is_fan && !is_sensor) || !id)
+      continue;
+
+    string label = chip_path.filename().string() + "/" + this->label(attr_fd, chip_path, chip, feature);
+    if (faccessat(attr_fd, attr.c_str(), R_OK, 0) != 0) {
+      LOG(llvl::debug) << label << ": unable to read from device";
+      continue;
+    }
+
+    if (is_fan) {
+      unique_ptr<Fan> fan;
+      if (is_dell) {
+        fan = make_unique<FanDell>(label, chip, *id);
+      } else {
+        fan = make_unique<FanSysfs>(label, chip, *id);
+      }
+
+      if (fan->valid()) {
+        fans.insert_or_assign(move(label), move(fan));
+      } else {
+        LOG(llvl::info) << *fan << ": mis-configured or unsupported";
+      }
+    } else { // is_sensor
+      unique_ptr<Sensor> sensor = make_unique<SensorSysfs>(label, chip, feature);
+
+      if (sensor->valid()) {
+        sensors.insert_or_assign(move(label), move(sensor));
+      } else {
+        LOG(llvl::info) << *sensor << ": mis-configured or unsupported";
       }
+    }
+  }
+
+  if (attr_fd != chip_fd)
+    close(attr_fd);
+}
+
+#ifdef FANCON_SENSORS_SUPPORT
+vector<fs::file_time_type> fc::HwmonScanner::config_times() {
+  // Where libsensors reads its config from; missing files read as the minimum
+  vector<path> paths{"/etc/sensors3.conf", "/etc/sensors.conf", "/etc/sensors.d"};
+  std::error_code ec;
+  for (const auto &e : fs::directory_iterator("/etc/sensors.d", ec))
+    paths.push_back(e.path());
+  std::sort(paths.begin() + 3, paths.end());
+
+  vector<fs::file_time_type> times;
+  for (const auto &p : paths) {
+    const auto t = fs::last_write_time(p, ec);
+    times.push_back((ec) ? fs::file_time_type::min() : t);
+  }
+  return times;
+}
+
+shared_ptr<const fc::HwmonScanner::ConfigLabels>
+fc::HwmonScanner::parse_config(vector<fs::file_time_type> times, const vector<string> &chips) {
+  auto c = make_shared<ConfigLabels>();
+  c->chips.insert(chips.begin(), chips.end());
+  c->config_times = move(times);
+
+  // lm-sensors is only consulted for labels set in its config (sensors3.conf & sensors.d)
+  if (sensors_init(nullptr) != 0)
+    return c;
+
+  const sensors_chip_name *sc;
+  for (int i = 0; (sc = sensors_get_detected_chips(nullptr, &i)) != nullptr;) {
+    const sensors_feature *sf;
+    for (int fnum = 0; (sf = sensors_get_features(sc, &fnum)) != nullptr;) {
+      if (sf->type != SENSORS_FEATURE_FAN && sf->type != SENSORS_FEATURE_TEMP)
+        continue;
 
-      if (is_fan) {
-        const auto id = Util::postfix_num<uint>(dev_name).value_or(0);
-        unique_ptr<Fan> fan;
-        if (is_dell) {
-          fan = make_unique<FanDell>(label, adapter_path, id);
-        } else {
-          fan = make_unique<FanSysfs>(label, adapter_path, id);
-        }
-
-        if (fan->valid()) {
-          fans.insert_or_assign(move(label), move(fan));
-        } else {
-          LOG(llvl::info) << *fan << ": mis-configured or unsupported";
-        }
-      } else { // is_sensor
-        string dev_path = string(adapter_path.c_str()) + "/" + dev_name;
-        unique_ptr<Sensor> sensor = make_unique<SensorSysfs>(label, move(dev_path));
-
-        if (sensor->valid()) {
-          sensors.insert_or_assign(move(label), move(sensor));
-        } else {
-          LOG(llvl::info) << *sensor << ": mis-configured or unsupported";
-        }
+      if (char *l = sensors_get_label(sc, sf); l != nullptr) {
+        c->labels.insert_or_assign(string(sc->path) + "/" + sf->name, l);
+        free(l);
       }
     }
   }
+
+  sensors_cleanup();
+  LOG(llvl::debug) << "Parsed lm-sensors config: " << c->labels.size() << " labels";
+  return c;
+}
+#endif // FANCON_SENSORS_SUPPORT
+
+string fc::HwmonScanner::label(int attr_fd, [[maybe_unused]] const path &chip_path, const Util::DirEntries &chip,
+                               const string &feature) const {
+#ifdef FANCON_SENSORS_SUPPORT
+  if (const auto it = config->labels.find(chip_path.string() + "/" + feature); it != config->labels.end())
+    return it->second;
+#endif // FANCON_SENSORS_SUPPORT
+
+  // Same fallbacks as lm-sensors: the driver's label, then the feature name
+  const string label_attr = feature + "_label";
+  if (chip.names.contains(label_attr))
+    return Util::read_line_at(attr_fd, label_attr).value_or(feature);
+
+  return feature;
 }
 
 fc::Devices::Devices(const fc_pb::Devices &d) { from(d); }
@@ -74,12 +185,14 @@ fc::Devices::Devices(bool enumerate) {
   if (!enumerate)
     return;
 
-  SensorChips().enumerate(fans, sensors);
+  HwmonScanner().enumerate(fans, sensors);
 
 #ifdef FANCON_NVIDIA_SUPPORT
   fc::FanNV::enumerate(fans);
   fc::SensorNV::enumerate(sensors);
 #endif // FANCON_NVIDIA_SUPPORT
+
+  index();
 }
 
 void fc::Devices::from(const fc_pb::Devices &d) {
@@ -91,6 +204,8 @@ void fc::Devices::from(const fc_pb::Devices &d) {
     case fc_pb::SYS:
     case fc_pb::DELL:s = make_shared<SensorSysfs>();
       break;
+    case fc_pb::VIRTUAL:s = make_shared<SensorVirtual>();
+      break;
     case fc_pb::NVIDIA:
 #ifdef FANCON_NVIDIA_SUPPORT
       if (!NV::xnvlib->supported) {
@@ -125,6 +240,8 @@ void fc::Devices::from(const fc_pb::Devices &d) {
     }
   }
 
+  link_sensors();
+
   for (const fc_pb::Fan &fpb : d.fan()) {
     unique_ptr<Fan> f;
 
@@ -165,6 +282,21 @@ void fc::Devices::from(const fc_pb::Devices &d) {
       LOG(llvl::warning) << *f << ": skipping invalid device from config";
     }
   }
+
+  for (const fc_pb::Zone &zpb : d.zone()) {
+    auto z = make_shared<Zone>();
+    z->from(zpb, sensors);
+    if (zones.contains(z->label)) {
+      LOG(llvl::warning) << *z << ": skipping duplicate zone in config";
+      continue;
+    }
+
+    string label = z->label;
+    zones.emplace(move(label), move(z));
+  }
+
+  link_zones();
+  index();
 }
 
 void fc::Devices::to(fc_pb::Devices &d) const {
@@ -173,6 +305,44 @@ void fc::Devices::to(fc_pb::Devices &d) const {
 
   for (const auto &[label, s] : sensors)
     s->to(*d.mutable_sensor()->Add());
+
+  for (const auto &[label, z] : zones)
+    z->to(*d.mutable_zone()->Add());
+}
+
+void fc::Devices::link_sensors() {
+  for (const auto &[label, s] : sensors)
+    s->link(sensors);
+}
+
+void fc::Devices::link_zones() {
+  map<string, shared_ptr<Zone>> fan_zones;
+  for (const auto &[zlabel, z] : zones) {
+    z->link(sensors);
+    for (const auto &flabel : z->fans) {
+      if (!fans.contains(flabel)) {
+        LOG(llvl::warning) << *z << ": fan '" << flabel << "' not found";
+      } else if (!fan_zones.try_emplace(flabel, z).second) {
+        LOG(llvl::warning) << flabel << ": already in zone "
+                           << *fan_zones[flabel] << ", skipping " << *z;
+      }
+    }
+  }
+
+  for (const auto &[flabel, f] : fans) {
+    const auto it = fan_zones.find(flabel);
+    f->join_zone((it != fan_zones.end()) ? it->second : nullptr);
+  }
+}
+
+void fc::Devices::index() {
+  fan_ids.clear();
+  for (const auto &[label, f] : fans)
+    fan_ids.emplace(f->hw_id(), label);
+
+  sensor_ids.clear();
+  for (const auto &[label, s] : sensors)
+    sensor_ids.emplace(s->hw_id(), label);
 }
 
 bool fc::operator==(const fc_pb::Fan &l, const fc_pb::Fan &r) {
@@ -1,7 +1,11 @@
 #ifndef FANCON_DEVICES_HPP
 #define FANCON_DEVICES_HPP
 
+#include <unordered_map>
+
+#ifdef FANCON_SENSORS_SUPPORT
 #include <sensors/sensors.h>
+#endif // FANCON_SENSORS_SUPPORT
 
 #include "dell/FanDell.hpp"
 #include "fan/Fan.hpp"
@@ -9,7 +13,9 @@
 #include "nvidia/NvidiaDevices.hpp"
 #include "sensor/Sensor.hpp"
 #include "sensor/SensorSysfs.hpp"
+#include "sensor/SensorVirtual.hpp"
 #include "util/Util.hpp"
+#include "zone/Zone.hpp"
 #include "proto/DevicesSpec.pb.h"
 
 using std::find_if;
@@ -17,15 +23,36 @@ using std::make_move_iterator;
 using std::set;
 
 namespace fc {
-class SensorChips {
+// Enumerates fans & sensors straight from /sys/class/hwmon, listing each
+// chip's attributes once rather than probing them one at a time
+class HwmonScanner {
 public:
-  SensorChips();
-  ~SensorChips();
+  HwmonScanner();
 
-  void enumerate(FanMap &fans, SensorMap &sensors);
+  static vector<string> chips();
+  void enumerate(FanMap &fans, SensorMap &sensors) const;
+  void enumerate(const string &chip, FanMap &fans, SensorMap &sensors) const;
 
 private:
-  vector<const sensors_chip_name *> chips;
+#ifdef FANCON_SENSORS_SUPPORT
+  struct ConfigLabels {
+    // Labels from lm-sensors' config, keyed by chip path & feature name
+    std::unordered_map<string, string> labels;
+    std::set<string> chips; // Present when parsed
+    vector<fs::file_time_type> config_times;
+  };
+  shared_ptr<const ConfigLabels> config;
+
+  static mutex config_mutex;
+  static shared_ptr<const ConfigLabels> parsed_config;
+
+  static vector<fs::file_time_type> config_times();
+  static shared_ptr<const ConfigLabels> parse_config(vector<fs::file_time_type> times,
+                                                     const vector<string> &chips);
+#endif // FANCON_SENSORS_SUPPORT
+
+  void enumerate_chip(int chip_fd, path chip_path, FanMap &fans, SensorMap &sensors) const;
+  string label(int attr_fd, const path &chip_path, const Util::DirEntries &chip, const string &feature) const;
 };
 
 class Devices {
@@ -35,9 +62,15 @@ public:
 
   FanMap fans;
   SensorMap sensors;
+  ZoneMap zones;
+  // Labels by hw_id, kept alongside the devices so merges match in O(1)
+  std::unordered_map<string, string> fan_ids, sensor_ids;
 
   void from(const fc_pb::Devices &d);
   void to(fc_pb::Devices &d) const;
+  void link_sensors();
+  void link_zones();
+  void index();
 };
 
 bool operator==(const fc_pb::Fan &l, const fc_pb::Fan &r);
@@ -0,0 +1,193 @@
+#include "Enumeration.hpp"
+
+fc::Enumeration::Enumeration() : stop_fd(eventfd(0, EFD_CLOEXEC)) {
+  // Subscribe before scanning, so no device added in between is missed
+  if (!subscribe())
+    LOG(llvl::warning) << "Hotplug events unavailable; enumerating devices on every use";
+
+  rescan();
+}
+
+void fc::Enumeration::watch(function<void()> changed_) {
+  // Events since subscribing wait in the socket until now
+  changed = move(changed_);
+  if (uevent_fd >= 0 && !listener.joinable())
+    listener = std::thread([this] { listen(); });
+}
+
+fc::Enumeration::~Enumeration() {
+  const uint64_t stop = 1;
+  if (write(stop_fd, &stop, sizeof(stop)) < 0)
+    LOG(llvl::error) << "Failed to stop hotplug listener";
+
+  if (listener.joinable())
+    listener.join();
+
+  if (uevent_fd >= 0)
+    close(uevent_fd);
+  close(stop_fd);
+}
+
+fc_pb::Devices fc::Enumeration::devices() {
+  // Without events nothing would invalidate the cache
+  if (uevent_fd < 0)
+    rescan();
+
+  fc_pb::Devices d;
+  const lock_guard<mutex> lg(cache_mutex);
+  for (const auto &[chip, chip_devices] : hwmon_chips)
+    d.MergeFrom(chip_devices);
+  d.MergeFrom(nvidia);
+  return d;
+}
+
+void fc::Enumeration::rescan_nvidia() {
+#ifdef FANCON_NVIDIA_SUPPORT
+  Devices d;
+  fc::FanNV::enumerate(d.fans);
+  fc::SensorNV::enumerate(d.sensors);
+
+  fc_pb::Devices pb;
+  d.to(pb);
+
+  const lock_guard<mutex> lg(cache_mutex);
+  nvidia = move(pb);
+#endif // FANCON_NVIDIA_SUPPORT
+}
+
+void fc::Enumeration::rescan() {
+  // Swapped in whole, so readers never see a partial scan
+  map<string, fc_pb::Devices> chips;
+  const HwmonScanner scanner;
+  for (const string &chip : HwmonScanner::chips())
+    chips.emplace(chip, scan_chip(scanner, chip));
+
+  {
+    const lock_guard<mutex> lg(cache_mutex);
+    hwmon_chips = move(chips);
+  }
+
+  rescan_nvidia();
+}
+
+fc_pb::Devices fc::Enumeration::scan_chip(const HwmonScanner &scanner, const string &chip) {
+  Devices d;
+  scanner.enumerate(chip, d.fans, d.sensors);
+
+  fc_pb::Devices pb;
+  d.to(pb);
+  return pb;
+}
+
+bool fc::Enumeration::subscribe() {
+  uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+  if (uevent_fd < 0)
+    return false;
+
+  // Hotplugging a GPU raises a burst of events; best effort to not drop any
+  setsockopt(uevent_fd, SOL_SOCKET, SO_RCVBUF, &UEVENT_RCVBUF, sizeof(UEVENT_RCVBUF));
+
+  sockaddr_nl addr{};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = UEVENT_KERNEL_GROUP;
+  if (bind(uevent_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0)
+    return true;
+
+  close(uevent_fd);
+  uevent_fd = -1;
+  return false;
+}
+
+void fc::Enumeration::listen() {
+  pollfd fds[] = {{stop_fd, POLLIN, 0}, {uevent_fd, POLLIN, 0}};
+  char buf[8192];
+  bool pending = false;
+
+  for (;;) {
+    // Once a burst of events settles, notify of all its changes at once
+    const int ready = poll(fds, 2, (pending) ? int(UEVENT_SETTLE.count()) : -1);
+    if (ready < 0 && errno != EINTR)
+      break;
+
+    if (fds[0].revents != 0)
+      return;
+
+    if (ready == 0) {
+      pending = false;
+      changed();
+      continue;
+    }
+
+    sockaddr_nl sender{};
+    socklen_t sender_len = sizeof(sender);
+    const ssize_t len = recvfrom(uevent_fd, buf, sizeof(buf), MSG_DONTWAIT,
+                                 reinterpret_cast<sockaddr *>(&sender), &sender_len);
+    if (len < 0) {
+      // Events were dropped, so the cache can no longer be trusted
+      if (errno == ENOBUFS) {
+        LOG(llvl::debug) << "Hotplug events overflowed, re-enumerating";
+        rescan();
+        pending = true;
+      }
+      continue;
+    }
+
+    // Only the kernel sends uevents; ignore anything forged from userspace
+    if (sender.nl_pid == 0)
+      pending |= apply(buf, len);
+  }
+
+  LOG(llvl::error) << "Hotplug listener failed: " << strerror(errno);
+}
+
+bool fc::Enumeration::apply(const char *msg, size_t len) {
+  // "action@devpath" header, followed by NUL separated KEY=value pairs
+  string_view action, devpath, subsystem;
+  for (size_t off = 0; off < len;) {
+    const string_view kv(msg + off, strnlen(msg + off, len - off));
+    off += kv.size() + 1;
+
+    const auto eq = kv.find('=');
+    if (eq == string_view::npos)
+      continue;
+
+    const auto key = kv.substr(0, eq), value = kv.substr(eq + 1);
+    if (key == "ACTION")
+      action = value;
+    else if (key == "DEVPATH")
+      devpath = value;
+    else if (key == "SUBSYSTEM")
+      subsystem = value;
+  }
+
+  if (subsystem == "hwmon") {
+    const string chip = path(devpath).filename().string();
+    LOG(llvl::debug) << "Hotplug " << action << ": " << chip;
+
+    // Descriptors held open for reading are stale once the chip is re-added or removed;
+    // older drivers keep their attributes on the parent device
+    const path sys_path = "/sys" + string(devpath);
+    HwmonChip::forget(sys_path);
+    HwmonChip::forget(sys_path.parent_path().parent_path());
+
+    if (action == "add" || action == "change") {
+      auto chip_devices = scan_chip(HwmonScanner(), chip);
+      const lock_guard<mutex> lg(cache_mutex);
+      hwmon_chips.insert_or_assign(chip, move(chip_devices));
+      return true;
+    } else if (action == "remove") {
+      const lock_guard<mutex> lg(cache_mutex);
+      return hwmon_chips.erase(chip) > 0;
+    }
+  } else if (subsystem == "drm" || subsystem == "pci") {
+    // NVIDIA devices are found through the driver rather than hwmon, so
+    // re-enumerate them when a GPU or its driver comes or goes
+    if (action == "add" || action == "remove" || action == "bind" || action == "unbind") {
+      LOG(llvl::debug) << "Hotplug " << action << ": " << devpath;
+      rescan_nvidia();
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,46 @@
+#ifndef FANCON_ENUMERATION_HPP
+#define FANCON_ENUMERATION_HPP
+
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+
+#include "Devices.hpp"
+#include "util/Util.hpp"
+#include "proto/DevicesSpec.pb.h"
+
+namespace fc {
+const milliseconds UEVENT_SETTLE(500);
+const uint32_t UEVENT_KERNEL_GROUP = 1;
+const int UEVENT_RCVBUF = 1 << 20;
+
+// Enumerated devices, cached & kept current by kernel uevents (hwmon, drm &
+// pci add/remove) rather than re-scanning all hardware on every use
+class Enumeration {
+public:
+  Enumeration();
+  ~Enumeration();
+
+  void watch(function<void()> changed_);
+  fc_pb::Devices devices();
+  void rescan_nvidia();
+
+private:
+  function<void()> changed;
+  int uevent_fd = -1, stop_fd = -1;
+  std::thread listener;
+  mutex cache_mutex;
+  map<string, fc_pb::Devices> hwmon_chips; // By class device, e.g. hwmon2
+  fc_pb::Devices nvidia;
+
+  void rescan();
+  static fc_pb::Devices scan_chip(const HwmonScanner &scanner, const string &chip);
+  bool subscribe();
+  void listen();
+  bool apply(const char *msg, size_t len);
+};
+} // namespace fc
+
+#endif // FANCON_ENUMERATION_HPP
@@ -0,0 +1,71 @@
+#include "Library.hpp"
+
+fc::Library::Library(path file_path_) : file_path(move(file_path_)) {
+  if (const auto cs = read(file_path); cs) {
+    merge(*cs);
+    LOG(llvl::debug) << "Library: " << entries.size() << " characterizations";
+  }
+}
+
+optional<fc_pb::Characterization>
+fc::Library::find(const string &fingerprint) const {
+  const lock_guard<mutex> lg(entries_mutex);
+  const auto it = entries.find(fingerprint);
+  return (it != entries.end()) ? optional(it->second) : nullopt;
+}
+
+void fc::Library::add(const fc_pb::Characterization &c) {
+  if (c.fingerprint().empty() || c.rpm_to_pwm().empty())
+    return;
+
+  const lock_guard<mutex> lg(entries_mutex);
+  entries[c.fingerprint()] = c;
+}
+
+void fc::Library::merge(const fc_pb::Characterizations &cs) {
+  // Imported results replace local ones for the same hardware
+  for (const auto &c : cs.characterization())
+    add(c);
+}
+
+void fc::Library::to(fc_pb::Characterizations &cs) const {
+  const lock_guard<mutex> lg(entries_mutex);
+  for (const auto &[fingerprint, c] : entries)
+    *cs.add_characterization() = c;
+}
+
+bool fc::Library::to_file() const {
+  // Tests finishing together would otherwise race to replace the file
+  const lock_guard<mutex> lg(file_mutex);
+  fc_pb::Characterizations cs;
+  to(cs);
+  return write(file_path, cs);
+}
+
+optional<fc_pb::Characterizations> fc::Library::read(const path &p) {
+  if (!exists(p))
+    return nullopt;
+
+  std::ifstream ifs(p);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  fc_pb::Characterizations cs;
+  if (!ifs || !google::protobuf::TextFormat::ParseFromString(ss.str(), &cs)) {
+    LOG(llvl::error) << "Failed to read characterizations: " << p;
+    return nullopt;
+  }
+
+  return cs;
+}
+
+bool fc::Library::write(const path &p, const fc_pb::Characterizations &cs) {
+  string out_s;
+  google::protobuf::TextFormat::PrintToString(cs, &out_s);
+
+  if (!Util::write_atomic(p, out_s)) {
+    LOG(llvl::error) << "Failed to write characterizations: " << p;
+    return false;
+  }
+
+  return true;
+}
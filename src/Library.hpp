@@ -0,0 +1,33 @@
+#ifndef FANCON_LIBRARY_HPP
+#define FANCON_LIBRARY_HPP
+
+#include <google/protobuf/text_format.h>
+#include <sstream>
+
+#include "util/Util.hpp"
+#include "proto/DevicesSpec.pb.h"
+
+namespace fc {
+// Characterizations (test results) keyed by hardware fingerprint, so fans on
+// identical hardware can skip testing
+class Library {
+public:
+  explicit Library(path file_path_);
+
+  optional<fc_pb::Characterization> find(const string &fingerprint) const;
+  void add(const fc_pb::Characterization &c);
+  void merge(const fc_pb::Characterizations &cs);
+  void to(fc_pb::Characterizations &cs) const;
+  bool to_file() const;
+
+  static optional<fc_pb::Characterizations> read(const path &p);
+  static bool write(const path &p, const fc_pb::Characterizations &cs);
+
+private:
+  path file_path;
+  mutable mutex entries_mutex, file_mutex;
+  map<string, fc_pb::Characterization> entries;
+};
+} // namespace fc
+
+#endif // FANCON_LIBRARY_HPP
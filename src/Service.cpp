@@ -57,14 +57,57 @@ Status fc::Service::SetDevices([[maybe_unused]] ServerContext *context,
   return Status::OK;
 }
 
-Status fc::Service::SubscribeDevices([[maybe_unused]] ServerContext *context,
-                                     [[maybe_unused]] const fc_pb::Empty *e,
+Status fc::Service::PatchDevices([[maybe_unused]] ServerContext *context,
+                                 const fc_pb::DevicesPatch *patch,
+                                 [[maybe_unused]] fc_pb::Empty *e) {
+  // Validate the whole patch before applying any of it
+  for (const auto &fp : patch->fan()) {
+    if (!controller.devices.fans.contains(fp.fan().label()))
+      return Status(StatusCode::NOT_FOUND, fp.fan().label());
+    if (const auto err = check_patch(fp.fan(), fp.mask()); err)
+      return *err;
+  }
+
+  for (const auto &sp : patch->sensor()) {
+    if (!controller.devices.sensors.contains(sp.sensor().label()))
+      return Status(StatusCode::NOT_FOUND, sp.sensor().label());
+    if (const auto err = check_patch(sp.sensor(), sp.mask()); err)
+      return *err;
+  }
+
+  controller.patch_devices(*patch);
+  return Status::OK;
+}
+
+Status fc::Service::SubscribeDevices(ServerContext *context,
+                                     const fc_pb::SubscribeFilter *filter,
                                      ServerWriter<fc_pb::Devices> *writer) {
+  mutex m;
+  optional<fc_pb::Devices> last_sent;
+  chrono::steady_clock::time_point last_sent_time;
+  bool pending = false;
+  const milliseconds min_interval(filter->min_interval());
+
   auto cb = [&](const fc::Devices &devices) {
+    if (context->IsCancelled())
+      return;
+
+    const lock_guard lg(m);
+    if (chrono::steady_clock::now() - last_sent_time < min_interval) {
+      pending = true; // Sent once the interval has elapsed
+      return;
+    }
+
+    fc_pb::Devices resp;
+    to(resp, devices, *filter);
+    pending = false;
+    if (last_sent && Util::deep_equal(resp, *last_sent))
+      return;
+
     if (!context->IsCancelled()) {
-      fc_pb::Devices resp;
-      devices.to(resp);
       writer->Write(resp);
+      last_sent = move(resp);
+      last_sent_time = chrono::steady_clock::now();
     }
   };
 
@@ -75,9 +118,18 @@ Status fc::Service::SubscribeDevices([[maybe_unused]] ServerContext *context,
   const auto it =
       controller.device_observers.insert(controller.device_observers.end(), cb);
 
-  while (!context->IsCancelled())
+  while (!context->IsCancelled()) {
     sleep_for(sleep_interval);
 
+    // Send any update held back by the min interval
+    const bool send_pending = [&] {
+      const lock_guard lg(m);
+      return pending;
+    }();
+    if (send_pending)
+      cb(controller.devices);
+  }
+
   // Acquire a removal lock before removing to ensure it's not in use
   controller.device_observers_mutex.acquire_removal_lock();
   controller.device_observers.erase(it);
@@ -89,7 +141,7 @@ Status
 fc::Service::GetEnumeratedDevices([[maybe_unused]] ServerContext *context,
                                   [[maybe_unused]] const fc_pb::Empty *req,
                                   fc_pb::Devices *devices) {
-  Devices(true).to(*devices);
+  *devices = controller.enumerated_devices();
   return Status::OK;
 }
 
@@ -108,6 +160,15 @@ Status fc::Service::SetControllerConfig([[maybe_unused]] ServerContext *context,
   return Status::OK;
 }
 
+Status fc::Service::SetProfile([[maybe_unused]] ServerContext *context,
+                               const fc_pb::ProfileName *p,
+                               [[maybe_unused]] fc_pb::Empty *e) {
+  if (!controller.set_profile(p->name()))
+    return Status(StatusCode::NOT_FOUND, p->name());
+
+  return Status::OK;
+}
+
 Status fc::Service::GetFanStatus([[maybe_unused]] ServerContext *context,
                                  const fc_pb::FanLabel *l,
                                  fc_pb::FanStatus *status) {
@@ -119,23 +180,70 @@ Status fc::Service::GetFanStatus([[maybe_unused]] ServerContext *context,
   status->set_status(controller.status(l->label()));
   status->set_rpm(fit->second->get_rpm());
   status->set_pwm(fit->second->get_pwm());
+  status->set_jitter(fit->second->get_jitter().count());
+  status->set_max_jitter(fit->second->get_max_jitter().count());
   return Status::OK;
 }
 
-Status fc::Service::SubscribeFanStatus([[maybe_unused]] ServerContext *context,
-                                       [[maybe_unused]] const fc_pb::Empty *e,
+Status fc::Service::SubscribeFanStatus(ServerContext *context,
+                                       const fc_pb::SubscribeFilter *filter,
                                        ServerWriter<fc_pb::FanStatus> *writer) {
   mutex m;
+  map<string, pair<chrono::steady_clock::time_point, fc_pb::FanStatus>>
+      last_sent;
+  const bool send_rpm = includes_field(*filter, "rpm"),
+             send_pwm = includes_field(*filter, "pwm"),
+             send_jitter = includes_field(*filter, "jitter");
+  const milliseconds min_interval(filter->min_interval());
+  const uint min_rpm_change = filter->min_rpm_change(),
+             min_pwm_change = filter->min_pwm_change();
+
+  const auto changed = [](uint prev, uint cur, uint min_change) {
+    return min_change > 0 &&
+           (std::max(prev, cur) - std::min(prev, cur)) >= min_change;
+  };
+
   const auto cb = [&](const Fan &f, const FanStatus status) {
-    if (!context->IsCancelled()) {
-      fc_pb::FanStatus resp;
-      resp.set_label(f.label);
-      resp.set_status(status);
+    if (context->IsCancelled() || !matches(*filter, f.label, f.type()))
+      return;
+
+    // Status changes are always sent, otherwise respect the min interval
+    const auto now = chrono::steady_clock::now();
+    optional<fc_pb::FanStatus> prev;
+    {
+      const lock_guard lg(m);
+      if (const auto it = last_sent.find(f.label); it != last_sent.end()) {
+        if (it->second.second.status() == status &&
+            now - it->second.first < min_interval)
+          return;
+        prev = it->second.second;
+      }
+    }
+
+    // Only read the fields that were requested
+    fc_pb::FanStatus resp;
+    resp.set_label(f.label);
+    resp.set_status(status);
+    if (send_rpm)
       resp.set_rpm(f.get_rpm());
+    if (send_pwm)
       resp.set_pwm(f.get_pwm());
-      const lock_guard lg(m);
-      if (!context->IsCancelled())
-        writer->Write(resp);
+    if (send_jitter) {
+      resp.set_jitter(f.get_jitter().count());
+      resp.set_max_jitter(f.get_max_jitter().count());
+    }
+
+    // Skip minor changes when a min change is set
+    if (prev && prev->status() == status &&
+        (min_rpm_change > 0 || min_pwm_change > 0) &&
+        !changed(prev->rpm(), resp.rpm(), min_rpm_change) &&
+        !changed(prev->pwm(), resp.pwm(), min_pwm_change))
+      return;
+
+    const lock_guard lg(m);
+    if (!context->IsCancelled()) {
+      writer->Write(resp);
+      last_sent.insert_or_assign(f.label, pair(now, move(resp)));
     }
   };
 
@@ -215,6 +323,103 @@ Status fc::Service::Test([[maybe_unused]] ServerContext *context,
   return Status::OK;
 }
 
+Status fc::Service::TestMany(ServerContext *context,
+                             const fc_pb::TestManyRequest *req,
+                             ServerWriter<fc_pb::TestResponse> *writer) {
+  // Resolve all fans before starting any tests
+  vector<Fan *> fans;
+  if (req->device_label().empty()) {
+    for (const auto &[flabel, f] : controller.devices.fans)
+      fans.push_back(f.get());
+  } else {
+    for (const auto &flabel : req->device_label()) {
+      const auto it = controller.devices.fans.find(flabel);
+      if (it == controller.devices.fans.end())
+        return Status(StatusCode::NOT_FOUND, flabel);
+      fans.push_back(it->second.get());
+    }
+  }
+
+  // Shared with the test callbacks, as the tests outlive a cancelled stream
+  struct Progress {
+    mutex m;
+    std::condition_variable cv;
+    size_t running = 0;
+    ServerWriter<fc_pb::TestResponse> *writer = nullptr;
+  };
+  const auto progress = make_shared<Progress>();
+  progress->writer = writer;
+
+  for (Fan *f : fans) {
+    auto cb = [progress, flabel = f->label](int &status) {
+      const lock_guard lg(progress->m);
+      if (progress->writer) {
+        fc_pb::TestResponse resp;
+        resp.set_device_label(flabel);
+        resp.set_status(status);
+        progress->writer->Write(resp);
+      }
+
+      if (status == 100 || status == -1) {
+        --progress->running;
+        progress->cv.notify_all();
+      }
+    };
+
+    {
+      const lock_guard lg(progress->m);
+      ++progress->running;
+    }
+    if (!controller.test(*f, req->forced(), false,
+                         make_shared<Util::ObservableNumber<int>>(cb))) {
+      const lock_guard lg(progress->m);
+      --progress->running;
+    }
+  }
+
+  // Only this thread waits; the tests run on the controller's tasks
+  std::unique_lock lock(progress->m);
+  const auto wait = std::chrono::milliseconds(sleep_interval.count());
+  while (progress->running > 0 && !context->IsCancelled())
+    progress->cv.wait_for(lock, wait);
+
+  progress->writer = nullptr;
+  return Status::OK;
+}
+
+Status fc::Service::CancelTest([[maybe_unused]] ServerContext *context,
+                               const fc_pb::FanLabel *l,
+                               [[maybe_unused]] fc_pb::Empty *resp) {
+  // Empty label cancels all running tests
+  if (l->label().empty()) {
+    for (const auto &[flabel, f] : controller.devices.fans)
+      controller.cancel_test(flabel);
+    return Status::OK;
+  }
+
+  if (!controller.devices.fans.contains(l->label()))
+    return Status(StatusCode::NOT_FOUND, l->label());
+
+  if (!controller.cancel_test(l->label()))
+    return Status(StatusCode::FAILED_PRECONDITION, l->label() + " isn't testing");
+
+  return Status::OK;
+}
+
+Status fc::Service::ExportProfiles([[maybe_unused]] ServerContext *context,
+                                   [[maybe_unused]] const fc_pb::Empty *e,
+                                   fc_pb::Characterizations *resp) {
+  controller.export_characterizations(*resp);
+  return Status::OK;
+}
+
+Status fc::Service::ImportProfiles([[maybe_unused]] ServerContext *context,
+                                   const fc_pb::Characterizations *cs,
+                                   [[maybe_unused]] fc_pb::Empty *resp) {
+  controller.import_characterizations(*cs);
+  return Status::OK;
+}
+
 Status fc::Service::Reload([[maybe_unused]] ServerContext *context,
                            [[maybe_unused]] const fc_pb::Empty *e,
                            [[maybe_unused]] fc_pb::Empty *resp) {
@@ -236,6 +441,67 @@ Status fc::Service::NvInit([[maybe_unused]] ServerContext *context,
   return Status::OK;
 }
 
+Status fc::Service::LatencyTest([[maybe_unused]] ServerContext *context,
+                                const fc_pb::LatencyTestRequest *req,
+                                fc_pb::LatencyTestResponse *resp) {
+  // Every CPU is kept busy for the duration, so don't allow it to run long
+  const milliseconds duration(req->duration());
+  if (duration > LATENCY_TEST_MAX_DURATION)
+    return Status(StatusCode::INVALID_ARGUMENT,
+                  "duration exceeds " + to_string(LATENCY_TEST_MAX_DURATION.count() / 1000) + "s");
+
+  const auto stats = controller.latency_test(duration);
+  resp->set_ticks(stats.ticks);
+  resp->set_max_delay(stats.max.count());
+  resp->set_mean_delay(stats.mean.count());
+  resp->set_realtime(rt_priority > 0);
+  return Status::OK;
+}
+
+bool fc::Service::matches(const fc_pb::SubscribeFilter &filter,
+                          const string &label, DevType type) {
+  const auto &labels = filter.label();
+  const auto &types = filter.type();
+  return (labels.empty() ||
+          std::find(labels.begin(), labels.end(), label) != labels.end()) &&
+         (types.empty() ||
+          std::find(types.begin(), types.end(), type) != types.end());
+}
+
+bool fc::Service::includes_field(const fc_pb::SubscribeFilter &filter,
+                                 const string &field) {
+  const auto &fields = filter.field();
+  return fields.empty() ||
+         std::find(fields.begin(), fields.end(), field) != fields.end();
+}
+
+void fc::Service::to(fc_pb::Devices &d, const fc::Devices &devices,
+                     const fc_pb::SubscribeFilter &filter) {
+  for (const auto &[label, f] : devices.fans) {
+    if (matches(filter, label, f->type()))
+      f->to(*d.mutable_fan()->Add());
+  }
+
+  for (const auto &[label, s] : devices.sensors) {
+    if (matches(filter, label, s->type()))
+      s->to(*d.mutable_sensor()->Add());
+  }
+
+  // Zones have no type; sent by their own label, or with any member fan
+  const auto &labels = filter.label();
+  for (const auto &[label, z] : devices.zones) {
+    const bool by_label =
+        filter.type().empty() &&
+        (labels.empty() || std::find(labels.begin(), labels.end(), label) != labels.end());
+    const bool by_fan = std::any_of(z->fans.begin(), z->fans.end(), [&](const string &flabel) {
+      const auto it = devices.fans.find(flabel);
+      return it != devices.fans.end() && matches(filter, flabel, it->second->type());
+    });
+    if (by_label || by_fan)
+      z->to(*d.mutable_zone()->Add());
+  }
+}
+
 void fc::Service::daemonize() {
   const auto fork_thread = []() {
     pid_t pid = fork();
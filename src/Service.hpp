@@ -1,9 +1,11 @@
 #ifndef FANCON_SERVICE_HPP
 #define FANCON_SERVICE_HPP
 
+#include <condition_variable>
 #include <csignal>
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/server.h>
+#include <google/protobuf/util/field_mask_util.h>
 #include <grpcpp/support/status.h>
 #include <mutex>
 #include <sys/stat.h>
@@ -42,7 +44,10 @@ public:
                     fc_pb::Devices *devices) override;
   Status SetDevices(ServerContext *context, const fc_pb::Devices *devices,
                     fc_pb::Empty *e) override;
-  Status SubscribeDevices(ServerContext *context, const fc_pb::Empty *e,
+  Status PatchDevices(ServerContext *context, const fc_pb::DevicesPatch *patch,
+                      fc_pb::Empty *e) override;
+  Status SubscribeDevices(ServerContext *context,
+                          const fc_pb::SubscribeFilter *filter,
                           ServerWriter<fc_pb::Devices> *writer) override;
   Status GetEnumeratedDevices(ServerContext *context, const fc_pb::Empty *e,
                               fc_pb::Devices *devices) override;
@@ -51,10 +56,13 @@ public:
   Status SetControllerConfig(ServerContext *context,
                              const fc_pb::ControllerConfig *config,
                              fc_pb::Empty *e) override;
+  Status SetProfile(ServerContext *context, const fc_pb::ProfileName *p,
+                    fc_pb::Empty *e) override;
 
   Status GetFanStatus(ServerContext *context, const fc_pb::FanLabel *l,
                       fc_pb::FanStatus *status) override;
-  Status SubscribeFanStatus(ServerContext *context, const fc_pb::Empty *e,
+  Status SubscribeFanStatus(ServerContext *context,
+                            const fc_pb::SubscribeFilter *filter,
                             ServerWriter<fc_pb::FanStatus> *writer) override;
   Status Enable(ServerContext *context, const fc_pb::FanLabel *l,
                 fc_pb::Empty *resp) override;
@@ -66,12 +74,24 @@ public:
                     fc_pb::Empty *resp) override;
   Status Test(ServerContext *context, const fc_pb::TestRequest *e,
               ServerWriter<fc_pb::TestResponse> *writer) override;
+  Status TestMany(ServerContext *context, const fc_pb::TestManyRequest *req,
+                  ServerWriter<fc_pb::TestResponse> *writer) override;
+  Status CancelTest(ServerContext *context, const fc_pb::FanLabel *l,
+                    fc_pb::Empty *resp) override;
+  Status ExportProfiles(ServerContext *context, const fc_pb::Empty *e,
+                        fc_pb::Characterizations *resp) override;
+  Status ImportProfiles(ServerContext *context,
+                        const fc_pb::Characterizations *cs,
+                        fc_pb::Empty *resp) override;
   Status Reload(ServerContext *context, const fc_pb::Empty *e,
                 fc_pb::Empty *resp) override;
   Status Recover(ServerContext *context, const fc_pb::Empty *e,
                  fc_pb::Empty *resp) override;
   Status NvInit(ServerContext *context, const fc_pb::Empty *e,
                 fc_pb::Empty *resp) override;
+  Status LatencyTest(ServerContext *context,
+                     const fc_pb::LatencyTestRequest *req,
+                     fc_pb::LatencyTestResponse *resp) override;
 
 private:
   fc::Controller controller;
@@ -79,10 +99,43 @@ private:
   const milliseconds sleep_interval = milliseconds(500);
 
   static void daemonize();
+  template <class M>
+  static optional<Status> check_patch(const M &m,
+                                      const google::protobuf::FieldMask &mask);
+  static bool matches(const fc_pb::SubscribeFilter &filter, const string &label,
+                      DevType type);
+  static bool includes_field(const fc_pb::SubscribeFilter &filter,
+                             const string &field);
+  static void to(fc_pb::Devices &d, const fc::Devices &devices,
+                 const fc_pb::SubscribeFilter &filter);
 
   //  static void signal_handler(int signal);
   //  static void register_signal_handler();
 };
 } // namespace fc
 
+//----------------------//
+// TEMPLATE DEFINITIONS //
+//----------------------//
+
+template <class M>
+optional<Status>
+fc::Service::check_patch(const M &m, const google::protobuf::FieldMask &mask) {
+  using google::protobuf::util::FieldMaskUtil;
+
+  if (!FieldMaskUtil::IsValidFieldMask<M>(mask))
+    return Status(StatusCode::INVALID_ARGUMENT,
+                  m.label() + ": invalid mask " +
+                      FieldMaskUtil::ToString(mask));
+
+  // Devices are keyed by label, and their type can't change in place
+  for (const auto &p : mask.paths()) {
+    if (p == "label" || p == "type")
+      return Status(StatusCode::INVALID_ARGUMENT,
+                    m.label() + ": " + p + " can't be patched");
+  }
+
+  return nullopt;
+}
+
 #endif // FANCON_SERVICE_HPP
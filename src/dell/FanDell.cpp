@@ -2,8 +2,8 @@
 
 using namespace fc;
 
-FanDell::FanDell(string label_, const path &adapter_path_, uint id_)
-    : FanSysfs(move(label_), adapter_path_, id_) {}
+FanDell::FanDell(string label_, const Util::DirEntries &chip, uint id_)
+    : FanSysfs(move(label_), chip, id_) {}
 
 FanDell::~FanDell() {
   if (enabled)
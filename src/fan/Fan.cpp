@@ -1,54 +1,98 @@
 #include "Fan.hpp"
+#include "sensor/ThermalEvents.hpp"
+#include "zone/Zone.hpp"
 
 fc::Fan::Fan(string label_) : label(move(label_)) {}
 
-void fc::Fan::update() {
-  const auto set = [&](Rpm rpm) {
-    rpm = smooth_rpm(rpm);
-    const Pwm target = find_closest_pwm(rpm);
-    set_pwm(target);
-
-    sleep_for_interval();
-
-    // Recover control if the PWM changes (after sleeping) from the target
-    //    if (get_pwm() != target) {
-    //      LOG(llvl::debug) << *this << ": mismatch (t, a) = (" << target
-    //                       << ", " << get_pwm() << ")";
-    //      return recover_control();
-    //    }
-  };
+bool fc::Fan::update() {
+  uint intervals = 1;
+  bool offloaded = false, recalibrated = false;
+  milliseconds tick;
+  {
+    const lock_guard<mutex> lg(update_mutex);
+    // The chip runs the curve itself when offloaded, only supervise it
+    if (supervise_offload()) {
+      intervals = OFFLOAD_SUPERVISE_INTERVALS;
+      offloaded = true;
+    } else {
+      // Only recompute when the input changed or smoothing is still converging
+      const uint64_t version = sample_input();
+      if (dirty || version != input_version || smoothing.targeted_rpm != target_rpm) {
+        dirty = false;
+        input_version = version;
+        target_rpm = (zone) ? percent_to_rpm(zone->get_percent()) : curve_rpm();
+        const Pwm pwm =
+            emergency() ? PWM_MAX : find_closest_pwm(smooth_rpm(target_rpm));
+        if (pwm != written_pwm && set_pwm(pwm)) {
+          written_pwm = pwm;
+          recalibration.pwm_since = chrono::steady_clock::now();
+        }
+      }
+
+      if (recalibrate)
+        recalibrated = observe_rpm();
+
+      if (adaptive_interval)
+        adapt_interval(written_pwm.value_or(PWM_MIN));
+    }
+    tick = tick_interval();
+  }
 
-  const Temp temp = sensor->get_average_temp();
+  if (thermal_events && !offloaded && ThermalEvents::listening())
+    wait_for_event(tick);
+  else
+    sleep_until_next(intervals * tick);
 
-  // Lower bound is >=; Upper bound is >
-  auto floor_it = temp_to_rpm.lower_bound(temp); // Floor now >= temp
+  // Recover control if the PWM changes (after sleeping) from the target
+  //    if (get_pwm() != target) {
+  //      LOG(llvl::debug) << *this << ": mismatch (t, a) = (" << target
+  //                       << ", " << get_pwm() << ")";
+  //      return recover_control();
+  //    }
 
-  // temp >= max temp; set to the highest RPM
-  if (floor_it == temp_to_rpm.end())
-    return set(next(floor_it, -1)->second);
+  return recalibrated;
+}
 
-  // temp <= min temp || temp == floor temp; set to the lowest RPM
-  if (floor_it == temp_to_rpm.begin() || floor_it->first == temp)
-    return set(floor_it->second);
+void fc::Fan::patch(const fc_pb::Fan &f, const SensorMap &sensor_map) {
+  // Applied in place, keeping the control & smoothing state
+  const lock_guard<mutex> lg(update_mutex);
+  from(f, sensor_map);
+  dirty = true;
+}
 
-  // min temp < temp < max temp
-  if (floor_it->first > temp) // Make floor <= temp
-    --floor_it;
+void fc::Fan::invalidate() {
+  // Rewrite the PWM next tick, e.g. after the driver may have reset it
+  const lock_guard<mutex> lg(update_mutex);
+  dirty = true;
+  written_pwm.reset();
+}
 
-  // Static; set to the closest RPM <= temp
-  if (!fc::dynamic)
-    return set(floor_it->second);
+void fc::Fan::compile_profiles(const vector<fc_pb::Profile> &profs) {
+  // Parse curves now so switching profile is only a pointer swap
+  map<string, Temp_to_Rpm_Map> compiled;
+  for (const auto &p : profs) {
+    if (const auto it = p.temp_to_rpm().find(label);
+        it != p.temp_to_rpm().end())
+      temp_to_rpm_from(it->second, compiled[p.name()]);
+  }
 
-  // Dynamic: find the RPM between the floor & ceiling
-  const auto ceil_it = next(floor_it); // ceil > target
-  const Rpm rpm_range = ceil_it->second - floor_it->second;
+  const lock_guard<mutex> lg(update_mutex);
+  curve = &temp_to_rpm;
+  profiles = move(compiled);
+  dirty = true;
+}
 
-  const double temp_range_weight =
-      static_cast<double>(temp) / (floor_it->first + ceil_it->first);
-  const Rpm dynamic_rpm =
-      floor_it->second + std::floor(temp_range_weight * rpm_range);
+void fc::Fan::use_profile(const string &name) {
+  const lock_guard<mutex> lg(update_mutex);
+  const auto it = profiles.find(name);
+  curve = (it != profiles.end()) ? &it->second : &temp_to_rpm;
+  dirty = true;
+}
 
-  set(dynamic_rpm);
+void fc::Fan::join_zone(shared_ptr<Zone> z) {
+  const lock_guard<mutex> lg(update_mutex);
+  zone = move(z);
+  dirty = true;
 }
 
 bool fc::Fan::tested() const {
@@ -62,6 +106,10 @@ bool fc::Fan::try_enable() {
     LOG(llvl::error) << *this << ": failed to enable";
     disable_control();
   } else {
+    next_tick_ns = 0;
+    max_jitter_us = 0;
+    dirty = true;
+    written_pwm.reset();
     return true;
   }
 
@@ -69,14 +117,19 @@ bool fc::Fan::try_enable() {
 }
 
 bool fc::Fan::is_configured(bool log) const {
-  const bool ce = temp_to_rpm.empty(), se = !sensor,
-             si = (sensor && sensor->ignore);
-  const bool configured = !(ce || se || si);
+  // Zone members use the zone's sensor & curve instead of their own
+  const bool z = bool(zone);
+  const bool ce = !z && curve->empty(), se = !z && !sensor,
+             si = !z && (sensor && sensor->ignore),
+             zc = z && !zone->is_configured(), te = z && rpm_to_pwm.empty();
+  const bool configured = !(ce || se || si || zc || te);
   if (!configured && log) {
     LOG(llvl::warning) << *this << ": skipping - "
                        << Util::join({{ce, "curve not configured"},
                                       {se, "sensor not configured"},
-                                      {si, "sensor ignored"}});
+                                      {si, "sensor ignored"},
+                                      {zc, "zone not configured"},
+                                      {te, "not tested"}});
   }
 
   return configured;
@@ -87,26 +140,46 @@ bool fc::Fan::set_pwm(Pwm pwm) {
   return true;
 }
 
-Pwm fc::Fan::find_closest_pwm(Rpm rpm) {
+Rpm fc::Fan::curve_rpm() {
+  return interpolate(*curve, sensor->get_average_temp());
+}
+
+Pwm fc::Fan::closest_pwm(Rpm rpm) const {
   // Find RPM closest to rpm
   const auto ge_it = rpm_to_pwm.lower_bound(rpm); // >= rpm
   if (ge_it == rpm_to_pwm.begin())                // rpm < the min point
     return ge_it->second;
 
   const auto le_it = next(ge_it, -1); // <= rpm
-  Pwm pwm;
-  if (ge_it != rpm_to_pwm.end()) {
-    // Choose the closer of two points
-    pwm = ((rpm - le_it->first) <= (ge_it->first - rpm)) ? le_it->second
-                                                         : ge_it->second;
-  } else {
-    pwm = le_it->second;
-  }
+  if (ge_it == rpm_to_pwm.end())
+    return le_it->second;
 
+  // Choose the closer of two points
+  return ((rpm - le_it->first) <= (ge_it->first - rpm)) ? le_it->second
+                                                        : ge_it->second;
+}
+
+Pwm fc::Fan::find_closest_pwm(Rpm rpm) {
+  const Pwm pwm = closest_pwm(rpm);
   const bool needs_starting = pwm > 0 && pwm < start_pwm && get_rpm() == 0;
   return (needs_starting) ? start_pwm : pwm;
 }
 
+bool fc::Fan::emergency() {
+  // Near critical, skip smoothing & stickiness to bound the reaction time
+  const auto s = control_sensor();
+  const optional<Temp> crit = (s) ? s->critical_temp() : nullopt;
+  if (!crit || s->get_average_temp() < *crit - fc::emergency_margin)
+    return false;
+
+  if (smoothing.targeted_rpm != rpm_to_pwm.rbegin()->first)
+    LOG(llvl::warning) << *this << ": near critical temp (" << *crit << "°C)";
+
+  smoothing.targeted_rpm = rpm_to_pwm.rbegin()->first;
+  smoothing.top_stickiness_rem_intervals = 0;
+  return true;
+}
+
 bool fc::Fan::recover_control() {
   for (auto i = 1; i <= 5; ++i, sleep_for_interval())
     if (enable_control()) {
@@ -133,7 +206,8 @@ Rpm fc::Fan::smooth_rpm(const Rpm rpm) {
   }
 
   // Be top sticky when a rpm decrease is requested
-  if (rpm_delta < 0) {
+  const bool increasing = rpm_delta > 0;
+  if (!increasing) {
     if (smoothing.top_stickiness_rem_intervals > 0) {
       smoothing.top_stickiness_rem_intervals--;
       return smoothing.targeted_rpm;
@@ -142,65 +216,344 @@ Rpm fc::Fan::smooth_rpm(const Rpm rpm) {
     smoothing.top_stickiness_rem_intervals = fc::top_stickiness_intervals;
   }
 
+  uint intervals = (increasing) ? fc::attack_intervals : fc::release_intervals;
+  if (intervals == 0)
+    intervals = tuned_intervals((increasing) ? rise_time : fall_time);
+  if (intervals == 0)
+    intervals = fc::smoothing_intervals;
+
   // Don't bother smoothing for minor RPM changes
-  if (rpm_delta < (0.1 * rpm_to_pwm.rbegin()->first)) {
+  if (intervals == 0 || abs(rpm_delta) < (0.1 * rpm_to_pwm.rbegin()->first)) {
     smoothing.targeted_rpm = rpm;
     return rpm;
   }
 
   // Restart smoothing on rpm target change
   if (rpm != smoothing.targeted_rpm || smoothing.targeted_rpm <= 0)
-    smoothing.rem_intervals = fc::smoothing_intervals;
+    smoothing.rem_intervals = intervals;
 
   smoothing.targeted_rpm += rpm_delta / smoothing.rem_intervals--;
   return smoothing.targeted_rpm;
 }
 
-void fc::Fan::sleep_for_interval() const {
-  sleep_for((interval.count() > 0) ? interval : fc::update_interval);
+uint64_t fc::Fan::sample_input() {
+  if (zone) {
+    zone->get_percent();
+    return zone->get_version();
+  }
+
+  sensor->get_average_temp();
+  return sensor->get_version();
+}
+
+bool fc::Fan::observe_rpm() {
+  // Sample once the PWM has been held long enough for the RPM to settle
+  const auto now = chrono::steady_clock::now();
+  const milliseconds settle = RECALIBRATE_SETTLE_TIME_CONSTANTS *
+                              std::max({rise_time, fall_time, base_interval()});
+  auto &r = recalibration;
+  if (!written_pwm || rpm_to_pwm.empty() || now - r.pwm_since < settle ||
+      now - r.last_sample < RECALIBRATE_SAMPLE_PERIOD)
+    return false;
+  r.last_sample = now;
+
+  // Stopped or stalled fans say nothing about drift
+  const Rpm expected = pwm_to_rpm(*written_pwm), observed = get_rpm();
+  if (expected == 0 || observed == 0)
+    return false;
+
+  // Fit observed = factor * expected, forgetting older observations
+  r.sxy = RECALIBRATE_FORGETTING * r.sxy + double(observed) * expected;
+  r.sxx = RECALIBRATE_FORGETTING * r.sxx + double(expected) * expected;
+  if (++r.samples < RECALIBRATE_MIN_SAMPLES)
+    return false;
+
+  const double factor = r.sxy / r.sxx;
+  if (std::abs(factor - 1) * 100 <= recalibrate_threshold)
+    return false;
+
+  LOG(llvl::info) << *this << ": recalibrating, RPM has drifted "
+                  << std::lround((factor - 1) * 100) << "% from rpm_to_pwm";
+  rescale_rpm_to_pwm(factor);
+  return true;
+}
+
+void fc::Fan::rescale_rpm_to_pwm(double factor) {
+  // Dust & bearing wear scale the whole curve, so keep each point's PWM
+  Rpm_to_Pwm_Map scaled;
+  for (const auto &[rpm, pwm] : rpm_to_pwm)
+    scaled[static_cast<Rpm>(std::lround(rpm * factor))] = pwm;
+  rpm_to_pwm = move(scaled);
+
+  recalibration.sxy = recalibration.sxx = 0;
+  recalibration.samples = 0;
+  dirty = true;
+}
+
+shared_ptr<fc::Sensor> fc::Fan::control_sensor() const {
+  return (zone) ? zone->get_sensor() : sensor;
+}
+
+void fc::Fan::adapt_interval(Pwm pwm) {
+  const auto s = control_sensor();
+  if (!s)
+    return;
+
+  const Temp temp = s->get_average_temp();
+  const auto now = chrono::steady_clock::now();
+  const double secs = chrono::duration<double>(now - adaptive.last_time).count();
+  const bool first = adaptive.interval.count() == 0;
+
+  if (!first && abs(temp - adaptive.last_temp) >= fc::fast_temp_rate * secs) {
+    // Changing fast, react sooner
+    adaptive.interval = std::min(fc::min_interval, base_interval());
+  } else if (!first && temp == adaptive.last_temp && pwm == adaptive.last_pwm) {
+    // Stable, back off up to the cap
+    adaptive.interval = std::max(
+        base_interval(), std::min(adaptive.interval * 2, fc::max_interval));
+  } else {
+    adaptive.interval = base_interval();
+  }
+
+  adaptive.last_time = now;
+  adaptive.last_temp = temp;
+  adaptive.last_pwm = pwm;
+}
+
+milliseconds fc::Fan::base_interval() const {
+  if (interval.count() > 0)
+    return interval;
+
+  // Sample a measured fan twice per time constant of its faster direction
+  if (rise_time.count() > 0 && fall_time.count() > 0)
+    return std::clamp(std::min(rise_time, fall_time) / 2, MIN_TUNED_INTERVAL,
+                      MAX_TUNED_INTERVAL);
+
+  return fc::update_interval;
+}
+
+uint fc::Fan::tuned_intervals(milliseconds time_constant) const {
+  // Smooth over about one time constant, as the fan can't follow any faster
+  if (time_constant.count() <= 0)
+    return 0;
+
+  const milliseconds base = base_interval();
+  return std::max<uint>(1, (time_constant + base - milliseconds(1)) / base);
+}
+
+milliseconds fc::Fan::tick_interval() const {
+  return (adaptive_interval && adaptive.interval.count() > 0) ? adaptive.interval
+                                                               : base_interval();
+}
+
+void fc::Fan::sleep_for_interval(uint intervals) const {
+  sleep_for(intervals * base_interval());
+}
+
+void fc::Fan::sleep_until_next(milliseconds period) {
+  // Deadlines advance from the last one, so work done each tick doesn't drift the period
+  const long period_ns = period.count() * 1'000'000L, now = Util::monotonic_ns();
+  next_tick_ns += period_ns;
+  if (next_tick_ns <= now) // First tick, or fell behind by a whole period; re-anchor
+    next_tick_ns = now + period_ns;
+
+  jitter_us = Util::sleep_until(next_tick_ns) / 1000;
+  if (jitter_us > max_jitter_us)
+    max_jitter_us = jitter_us.load();
+}
+
+chrono::microseconds fc::Fan::get_jitter() const {
+  return chrono::microseconds(jitter_us);
+}
+
+chrono::microseconds fc::Fan::get_max_jitter() const {
+  return chrono::microseconds(max_jitter_us);
+}
+
+void fc::Fan::wait_for_event(milliseconds tick) {
+  // Keep the usual pace until smoothing settles after an event, then idle
+  if (event_ticks > 0) {
+    --event_ticks;
+    return sleep_until_next(tick);
+  }
+
+  if (ThermalEvents::wait_for(baseline_interval))
+    event_ticks = smoothing_intervals + top_stickiness_intervals;
+
+  // Ticks after waiting are scheduled from now
+  next_tick_ns = Util::monotonic_ns();
 }
 
-bool fc::Fan::test(ObservableNumber<int> &status) {
+fc::Task<bool> fc::Fan::test(ObservableNumber<int> &status,
+                             function<void()> checkpointed) {
   const Pwm pre_pwm = get_pwm();
+  test_cancelled = false;
+
+  try {
+    // Fail early if can't write enable mode or pwm
+    if (!enable_control() || !co_await set_pwm_test()) {
+      LOG(llvl::error) << *this << ": failed to take control";
+      disable_control();
+      status = -1;
+      co_return false;
+    }
 
-  // Fail early if can't write enable mode or pwm
-  if (!enable_control() || !set_pwm_test()) {
-    LOG(llvl::error) << *this << ": failed to take control";
-    disable_control();
+    co_await test_phases(status, checkpointed);
+  } catch (const TestCancelled &e) {
+    // Completed phases stay checkpointed for the next test to resume from
+    LOG(llvl::info) << *this << ": " << e.what();
+    set_pwm(pre_pwm);
     status = -1;
-    return false;
+    co_return false;
+  }
+
+  // Restore pre-test Rpm
+  set_pwm(pre_pwm);
+  status = 100;
+  co_return true;
+}
+
+void fc::Fan::cancel_test() { test_cancelled = true; }
+
+void fc::Fan::resume_test_from(const Fan &other) {
+  // Completed phases carry over to a replacement device for the same fan
+  const std::scoped_lock lock(update_mutex, other.update_mutex);
+  if (other.checkpoint.phase() > checkpoint.phase())
+    checkpoint = other.checkpoint;
+}
+
+fc::Task<> fc::Fan::test_sleep(milliseconds duration) const {
+  // Sleep in slices so a cancellation is noticed promptly
+  for (auto rem = duration; rem.count() > 0; rem -= TEST_CANCEL_POLL) {
+    co_await Executor::sleep(std::min(rem, TEST_CANCEL_POLL));
+    if (test_cancelled)
+      throw TestCancelled();
   }
+}
 
+fc::Task<> fc::Fan::test_phases(ObservableNumber<int> &status,
+                                const function<void()> &checkpointed) {
   Pwm_to_Rpm_Map pwm_to_rpm;
-  status = 0;
+  uint phase;
+  {
+    const lock_guard<mutex> lg(update_mutex);
+    phase = std::min<uint>(checkpoint.phase(), TEST_PHASE_PROGRESS.size());
+    pwm_to_rpm.insert(checkpoint.pwm_to_rpm().begin(), checkpoint.pwm_to_rpm().end());
+    if (phase > 0)
+      start_pwm = clamp_pwm(checkpoint.start_pwm());
+    rise_time = fall_time = milliseconds(0); // Stabilise at the default interval
+  }
 
-  test_stopped(pwm_to_rpm);
-  status += 20;
-  test_start(pwm_to_rpm);
-  status += 30;
-  test_running_min(pwm_to_rpm);
-  status += 25;
-  test_mapping(pwm_to_rpm);
-  status = 100;
+  if (phase > 0)
+    LOG(llvl::info) << *this << ": resuming test after phase " << phase;
+
+  status = (phase > 0) ? TEST_PHASE_PROGRESS[phase - 1] : 0;
+
+  // Persist each completed phase, so an interrupted test can resume from it
+  const auto completed = [&](uint p) {
+    save_checkpoint(p, pwm_to_rpm);
+    status = TEST_PHASE_PROGRESS[p - 1];
+    if (checkpointed)
+      checkpointed();
+  };
+
+  if (phase < 1) {
+    co_await test_stopped(pwm_to_rpm);
+    completed(1);
+  }
+  if (phase < 2) {
+    co_await test_start(pwm_to_rpm);
+    completed(2);
+  }
+  if (phase < 3) {
+    co_await test_running_min(pwm_to_rpm);
+    completed(3);
+  }
+  if (phase < 4) {
+    co_await test_mapping(pwm_to_rpm);
+    completed(4);
+  }
+  co_await test_response(pwm_to_rpm);
 
+  const lock_guard<mutex> lg(update_mutex);
   rpm_to_pwm_from(pwm_to_rpm);
+  recalibration = {};
+  checkpoint.Clear();
+  dirty = true;
+  written_pwm.reset();
+}
 
-  // Restore pre-test Rpm
-  set_pwm(pre_pwm);
-  return true;
+void fc::Fan::save_checkpoint(uint phase, const Pwm_to_Rpm_Map &pwm_to_rpm) {
+  const lock_guard<mutex> lg(update_mutex);
+  checkpoint.set_phase(phase);
+  checkpoint.set_start_pwm(start_pwm);
+  auto &points = *checkpoint.mutable_pwm_to_rpm();
+  points.clear();
+  points.insert(pwm_to_rpm.begin(), pwm_to_rpm.end());
 }
 
-optional<Rpm> fc::Fan::set_stabilised_pwm(const Pwm pwm) {
+fc::Task<bool> fc::Fan::use_characterization(const fc_pb::Characterization &c,
+                                             bool check,
+                                             ObservableNumber<int> &status) {
+  Rpm_to_Pwm_Map mapping;
+  rpm_to_pwm_from(c.rpm_to_pwm(), mapping);
+  if (mapping.empty())
+    co_return false;
+
+  status = 0;
+  if (check) {
+    const Pwm pre_pwm = get_pwm();
+    test_cancelled = false;
+    bool matched = false;
+    try {
+      matched = enable_control() && co_await spot_check(mapping);
+    } catch (const TestCancelled &e) {
+      LOG(llvl::info) << *this << ": " << e.what();
+    }
+    set_pwm(pre_pwm);
+    if (!matched)
+      co_return false;
+  }
+
+  {
+    const lock_guard<mutex> lg(update_mutex);
+    rpm_to_pwm = move(mapping);
+    start_pwm = clamp_pwm(c.start_pwm());
+    rise_time = milliseconds(c.rise_time());
+    fall_time = milliseconds(c.fall_time());
+    recalibration = {};
+    checkpoint.Clear();
+    dirty = true;
+    written_pwm.reset();
+  }
+
+  LOG(llvl::info) << *this << ": using library characterization";
+  status = 100;
+  co_return true;
+}
+
+void fc::Fan::characterization_to(fc_pb::Characterization &c) const {
+  c.set_fingerprint(fingerprint());
+  const lock_guard<mutex> lg(update_mutex);
+  c.set_rpm_to_pwm(Util::map_str(rpm_to_pwm));
+  c.set_start_pwm(start_pwm);
+  c.set_rise_time(rise_time.count());
+  c.set_fall_time(fall_time.count());
+}
+
+string fc::Fan::fingerprint() const { return hw_id(); }
+
+fc::Task<optional<Rpm>> fc::Fan::set_stabilised_pwm(const Pwm pwm) {
   if (!set_pwm(pwm))
-    return nullopt;
+    co_return nullopt;
 
   // Rpm must not increase more than 5% twice consecutively to be 'stable'
   Rpm cur = get_rpm(), prev = 0;
   uint reached = 0;
   while (reached <= 3) {
-    sleep_for_interval();
+    co_await test_sleep(base_interval());
     if (get_pwm() != pwm)
-      return nullopt;
+      co_return nullopt;
 
     prev = cur;
     cur = get_rpm();
@@ -210,73 +563,95 @@ optional<Rpm> fc::Fan::set_stabilised_pwm(const Pwm pwm) {
             : 0;
   }
 
-  return cur;
+  co_return cur;
 }
 
-bool fc::Fan::set_pwm_test() {
+fc::Task<bool> fc::Fan::set_pwm_test() {
   const Pwm target = (get_pwm() != PWM_MIN) ? PWM_MIN : PWM_MAX;
   if (!set_pwm(target))
-    return false;
+    co_return false;
 
-  for (int i = 0; i < 10; ++i, sleep_for_interval()) {
+  for (int i = 0; i < 10; ++i) {
     if (get_pwm() == target)
-      return true;
-    //    if (set_stabilised_pwm(target).has_value())
-    //      return true;
+      co_return true;
+    co_await test_sleep(base_interval());
   }
-  return false;
+  co_return false;
 }
 
-void fc::Fan::test_stopped(Pwm_to_Rpm_Map &pwm_to_rpm) {
-  set_stabilised_pwm(PWM_MIN);
+fc::Task<> fc::Fan::test_stopped(Pwm_to_Rpm_Map &pwm_to_rpm) {
+  co_await set_stabilised_pwm(PWM_MIN);
   pwm_to_rpm[get_pwm()] = get_rpm(); // Ideally RPM will now be 0
 }
 
-void fc::Fan::test_start(Pwm_to_Rpm_Map &pwm_to_rpm) {
+fc::Task<> fc::Fan::test_start(Pwm_to_Rpm_Map &pwm_to_rpm) {
   Pwm target_pwm = fc::PWM_MIN;
   optional<Rpm> cur_rpm = 0;
   while ((!cur_rpm || *cur_rpm == 0) && target_pwm <= fc::PWM_MAX) {
-    cur_rpm = set_stabilised_pwm(target_pwm);
+    cur_rpm = co_await set_stabilised_pwm(target_pwm);
     target_pwm += 2;
   }
 
   // Driver may have altered the PWM from that set, also be conservative
   target_pwm = min(target_pwm + 6, PWM_MAX);
-  sleep_for_interval();
-  start_pwm = get_pwm();
-  pwm_to_rpm[start_pwm] = *cur_rpm;
+  co_await test_sleep(base_interval());
+  const Pwm start = get_pwm();
+  {
+    const lock_guard<mutex> lg(update_mutex);
+    start_pwm = start;
+  }
+  pwm_to_rpm[start] = *cur_rpm;
 }
 
-void fc::Fan::test_interval(Pwm_to_Rpm_Map &pwm_to_rpm) {
-  if (interval > milliseconds(0)) // Use user's set interval if configured
-    return;
-
-  set_stabilised_pwm(PWM_MIN);
-
-  // Method 1: time taken from min pwm (stopped) to start RPM
-  // Method 2: if fan can't stop - time taken from min pwm to max pwm
-  const auto start =
-      (!pwm_to_rpm.empty()) ? next(pwm_to_rpm.begin()) : pwm_to_rpm.end();
-  const Pwm target_pwm = (start_pwm != PWM_MIN && start != pwm_to_rpm.end())
-                             ? start->first
-                             : PWM_MAX;
+fc::Task<> fc::Fan::test_response(const Pwm_to_Rpm_Map &pwm_to_rpm) {
+  // Step between the lowest running & max PWM in each direction
+  const auto low = pwm_to_rpm.lower_bound(start_pwm);
+  const auto high = pwm_to_rpm.rbegin();
+  if (low == pwm_to_rpm.end() || low->second >= high->second)
+    co_return;
+
+  const auto rise = co_await step_time_constant(low->first, high->first, high->second),
+             fall = co_await step_time_constant(high->first, low->first, low->second);
+  {
+    const lock_guard<mutex> lg(update_mutex);
+    rise_time = rise.value_or(milliseconds(0));
+    fall_time = fall.value_or(milliseconds(0));
+  }
+  LOG(llvl::debug) << *this << ": rise " << rise.value_or(milliseconds(0)).count()
+                   << "ms, fall " << fall.value_or(milliseconds(0)).count() << "ms";
+}
 
-  const auto pre = chrono::high_resolution_clock::now();
-  if (!set_stabilised_pwm(target_pwm))
-    return;
+fc::Task<optional<milliseconds>> fc::Fan::step_time_constant(Pwm from, Pwm to,
+                                                             Rpm to_rpm) {
+  const auto from_rpm = co_await set_stabilised_pwm(from);
+  if (!from_rpm || !set_pwm(to))
+    co_return nullopt;
+
+  // Time taken to cover 63% of the step, as for a first order system
+  const int step = int(to_rpm) - int(*from_rpm);
+  const int threshold = int(*from_rpm) + int(0.632 * step);
+  const auto pre = chrono::steady_clock::now();
+  for (auto elapsed = milliseconds(0); elapsed < RESPONSE_TIMEOUT;
+       elapsed = chrono::duration_cast<milliseconds>(chrono::steady_clock::now() - pre)) {
+    const int rpm = get_rpm();
+    if ((step > 0) ? rpm >= threshold : rpm <= threshold)
+      co_return elapsed;
+
+    co_await test_sleep(RESPONSE_SAMPLE_INTERVAL);
+  }
 
-  interval = chrono::duration_cast<milliseconds>(
-      chrono::high_resolution_clock::now() - pre);
+  LOG(llvl::warning) << *this << ": no response to PWM " << from << " -> " << to;
+  co_return nullopt;
 }
 
-void fc::Fan::test_running_min(Pwm_to_Rpm_Map &pwm_to_rpm) {
+fc::Task<> fc::Fan::test_running_min(Pwm_to_Rpm_Map &pwm_to_rpm) {
   // Slowly drop PWM until fan is no longer running
   // Don't take the last 3 results before it stopped to be safe
   vector<tuple<Pwm, Rpm>> results;
   Pwm target_pwm = start_pwm;
 
   for (optional<Rpm> cur_rpm; target_pwm >= PWM_MIN; target_pwm -= 2) {
-    cur_rpm = set_stabilised_pwm(target_pwm);
+    cur_rpm = co_await set_stabilised_pwm(target_pwm);
     if (!cur_rpm)
       continue;
 
@@ -294,16 +669,31 @@ void fc::Fan::test_running_min(Pwm_to_Rpm_Map &pwm_to_rpm) {
   }
 }
 
-void fc::Fan::test_mapping(Pwm_to_Rpm_Map &pwm_to_rpm) {
+fc::Task<> fc::Fan::test_mapping(Pwm_to_Rpm_Map &pwm_to_rpm) {
   // Record points from start PWM to PWM_MAX
   // Ensure target hits 128 (even) && 255 (odd)
   Pwm target = min(start_pwm + ((start_pwm % 2 != 0) ? 1 : 2), PWM_MAX);
   for (; target <= PWM_MAX; target += (target < PWM_MAX - 1) ? 2 : 1) {
-    if (const auto cur_rpm = set_stabilised_pwm(target); cur_rpm)
+    if (const auto cur_rpm = co_await set_stabilised_pwm(target); cur_rpm)
       pwm_to_rpm[target] = *cur_rpm;
   }
 }
 
+fc::Task<bool> fc::Fan::spot_check(const Rpm_to_Pwm_Map &expected) {
+  // Compare the middle & top running points, which most of the curve lies between
+  const auto mid = expected.lower_bound(expected.rbegin()->first / 2);
+  for (const auto &[rpm, pwm] : {*mid, *expected.rbegin()}) {
+    const auto actual = co_await set_stabilised_pwm(pwm);
+    if (!actual || std::abs(int(*actual) - int(rpm)) > SPOT_CHECK_TOLERANCE * rpm) {
+      LOG(llvl::info) << *this << ": spot check failed at PWM " << pwm << ", "
+                      << actual.value_or(0) << "rpm, expected " << rpm << "rpm";
+      co_return false;
+    }
+  }
+
+  co_return true;
+}
+
 Percent fc::Fan::rpm_to_percent(const Rpm rpm) const {
   if (rpm <= 0)
     return 0;
@@ -341,8 +731,10 @@ Rpm fc::Fan::percent_to_rpm(Percent percent) const {
 
   // 1% is the min running RPM
   const Rpm range = max_it->first - min_running_it->first;
-  return (percent == 1) ? min_running_it->first
-                        : ((percent / 100) * range) + min_running_it->first;
+  return (percent == 1)
+             ? min_running_it->first
+             : static_cast<Rpm>((percent / 100.0) * range) +
+                   min_running_it->first;
 }
 
 Rpm fc::Fan::pwm_to_rpm(Pwm pwm) const {
@@ -372,7 +764,8 @@ Rpm fc::Fan::pwm_to_rpm(Pwm pwm) const {
   return (--it)->first;
 }
 
-void fc::Fan::temp_to_rpm_from(const string &src) {
+void fc::Fan::temp_to_rpm_from(const string &src,
+                               Temp_to_Rpm_Map &dst) const {
   if (rpm_to_pwm.empty()) // Fan needs to be tested first
     return;
 
@@ -409,7 +802,7 @@ void fc::Fan::temp_to_rpm_from(const string &src) {
     else if (is_pwm)
       *rpm = pwm_to_rpm(*rpm);
 
-    temp_to_rpm[*temp] = *rpm;
+    dst[*temp] = *rpm;
 
     if (min_temp && *temp < *min_temp) {
       LOG(llvl::warning) << *this << ": " << *temp << "°C < sensor min ("
@@ -421,7 +814,7 @@ void fc::Fan::temp_to_rpm_from(const string &src) {
   }
 }
 
-void fc::Fan::rpm_to_pwm_from(const string &src) {
+void fc::Fan::rpm_to_pwm_from(const string &src, Rpm_to_Pwm_Map &dst) const {
   string::const_iterator start_it = src.begin(), next_it = src.end();
   std::smatch m;
   const auto next_item = [&] {
@@ -436,7 +829,7 @@ void fc::Fan::rpm_to_pwm_from(const string &src) {
     const auto rpm = Util::from_string<Rpm>(m[1]),
                pwm = Util::from_string<Pwm>(m[2]);
     if (rpm && pwm) {
-      rpm_to_pwm[*rpm] = clamp_pwm(*pwm);
+      dst[*rpm] = clamp_pwm(*pwm);
     } else {
       LOG(llvl::error) << *this << ": invalid rpm_to_pwm item: " << m[0];
     }
@@ -462,24 +855,35 @@ void fc::Fan::rpm_to_pwm_from(const Pwm_to_Rpm_Map &pwm_to_rpm) {
 
 void fc::Fan::from(const fc_pb::Fan &f, const SensorMap &sensor_map) {
   label = f.label();
-  if (const auto s_it = sensor_map.find(f.sensor()); s_it != sensor_map.end())
-    sensor = s_it->second;
+  const auto s_it = sensor_map.find(f.sensor());
+  sensor = (s_it != sensor_map.end()) ? s_it->second : nullptr;
 
-  rpm_to_pwm_from(f.rpm_to_pwm());
-  temp_to_rpm_from(f.temp_to_rpm());
+  rpm_to_pwm.clear();
+  temp_to_rpm.clear();
+  rpm_to_pwm_from(f.rpm_to_pwm(), rpm_to_pwm);
+  temp_to_rpm_from(f.temp_to_rpm(), temp_to_rpm);
   start_pwm = clamp_pwm(f.start_pwm());
   interval = milliseconds(f.interval());
+  rise_time = milliseconds(f.rise_time());
+  fall_time = milliseconds(f.fall_time());
+  checkpoint = f.checkpoint();
   ignore = f.ignore();
 }
 
 void fc::Fan::to(fc_pb::Fan &f) const {
+  // The fan thread, tests & recalibration modify these concurrently
+  const lock_guard<mutex> lg(update_mutex);
   f.set_label(label);
   f.set_sensor(sensor ? sensor->label : "");
   f.set_rpm_to_pwm(Util::map_str(rpm_to_pwm));
   f.set_temp_to_rpm(Util::map_str(temp_to_rpm));
   f.set_start_pwm(start_pwm);
   f.set_interval(interval.count());
+  f.set_rise_time(rise_time.count());
+  f.set_fall_time(fall_time.count());
   f.set_ignore(ignore);
+  if (checkpoint.phase() > 0)
+    *f.mutable_checkpoint() = checkpoint;
 }
 
 bool fc::Fan::deep_equal(const Fan &other) const {
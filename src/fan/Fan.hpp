@@ -1,10 +1,12 @@
 #ifndef FANCON_FAN_HPP
 #define FANCON_FAN_HPP
 
+#include <array>
 #include <cmath>
 #include <regex>
 
 #include "sensor/Sensor.hpp"
+#include "util/Executor.hpp"
 #include "util/Util.hpp"
 #include "proto/DevicesSpec.pb.h"
 
@@ -26,13 +28,41 @@ extern milliseconds update_interval;
 extern bool dynamic;
 extern uint smoothing_intervals;
 extern uint top_stickiness_intervals;
+extern uint attack_intervals;
+extern uint release_intervals;
+extern Temp emergency_margin;
+extern bool adaptive_interval;
+extern milliseconds min_interval;
+extern milliseconds max_interval;
+extern double fast_temp_rate;
+extern bool thermal_events;
+extern milliseconds baseline_interval;
+extern bool recalibrate;
+extern uint recalibrate_threshold;
 enum class ControllerState;
 extern ControllerState controller_state;
 
 const Pwm PWM_MIN = 0, PWM_MAX = 255;
 const double STABILISED_THRESHOLD = 0.1;
+const uint OFFLOAD_SUPERVISE_INTERVALS = 10;
+const milliseconds RESPONSE_SAMPLE_INTERVAL(50), RESPONSE_TIMEOUT(30000);
+const milliseconds MIN_TUNED_INTERVAL(100), MAX_TUNED_INTERVAL(2000);
+const milliseconds TEST_CANCEL_POLL(100);
+const milliseconds RECALIBRATE_SAMPLE_PERIOD(5000);
+const uint RECALIBRATE_MIN_SAMPLES = 20, RECALIBRATE_SETTLE_TIME_CONSTANTS = 3;
+const double RECALIBRATE_FORGETTING = 0.95;
+const double SPOT_CHECK_TOLERANCE = 0.15;
+const std::array<int, 4> TEST_PHASE_PROGRESS = {20, 50, 75, 90};
+
+class TestCancelled : public runtime_error {
+public:
+  TestCancelled() : runtime_error("test cancelled") {}
+};
+
+class Zone;
 
 Pwm clamp_pwm(Pwm pwm);
+template <class T> T interpolate(const std::map<Temp, T> &curve, Temp temp);
 
 class Fan {
 public:
@@ -43,8 +73,22 @@ public:
   string label;
   bool ignore{false};
 
-  void update();
-  virtual bool test(ObservableNumber<int> &status);
+  bool update(); // True when rpm_to_pwm was recalibrated
+  void patch(const fc_pb::Fan &f, const SensorMap &sensor_map);
+  void compile_profiles(const vector<fc_pb::Profile> &profiles);
+  void use_profile(const string &name);
+  void join_zone(shared_ptr<Zone> z);
+  void invalidate();
+  virtual Task<bool> test(ObservableNumber<int> &status,
+                          function<void()> checkpointed);
+  void cancel_test();
+  void resume_test_from(const Fan &other);
+  Task<bool> use_characterization(const fc_pb::Characterization &c,
+                                  bool check, ObservableNumber<int> &status);
+  void characterization_to(fc_pb::Characterization &c) const;
+  virtual string fingerprint() const;
+  chrono::microseconds get_jitter() const;
+  chrono::microseconds get_max_jitter() const;
   bool tested() const;
   bool try_enable();
   bool is_configured(bool log) const;
@@ -54,7 +98,7 @@ public:
   virtual Pwm get_pwm() const = 0;
   virtual Rpm get_rpm() const = 0;
   virtual bool valid() const = 0;
-  virtual string hw_id() const = 0;
+  const string &hw_id() const { return uid; }
   virtual DevType type() const = 0;
 
   virtual void from(const fc_pb::Fan &f, const SensorMap &sensor_map);
@@ -64,12 +108,26 @@ public:
   friend std::ostream &operator<<(std::ostream &os, const Fan &f);
 
 protected:
+  string uid; // hw_id, precomputed whenever the device's paths or id change
   shared_ptr<fc::Sensor> sensor;
+  shared_ptr<fc::Zone> zone;
   Rpm_to_Pwm_Map rpm_to_pwm;
   Temp_to_Rpm_Map temp_to_rpm;
+  map<string, Temp_to_Rpm_Map> profiles;
+  const Temp_to_Rpm_Map *curve = &temp_to_rpm;
   Pwm start_pwm = 0;
-  milliseconds interval{0};
+  milliseconds interval{0}, rise_time{0}, fall_time{0};
   bool enabled = false;
+  uint event_ticks = 0;
+  bool dirty = true;
+  uint64_t input_version = 0;
+  Rpm target_rpm = 0;
+  optional<Pwm> written_pwm;
+  long next_tick_ns = 0;
+  std::atomic_bool test_cancelled{false};
+  fc_pb::TestCheckpoint checkpoint;
+  std::atomic<long> jitter_us{0}, max_jitter_us{0};
+  mutable mutex update_mutex;
 
   struct {
     bool just_started{true};
@@ -78,25 +136,58 @@ protected:
     int top_stickiness_rem_intervals{0};
   } smoothing;
 
+  struct {
+    chrono::steady_clock::time_point pwm_since, last_sample;
+    double sxy{0}, sxx{0}; // Least squares sums of observed & expected RPM
+    uint samples{0};
+  } recalibration;
+
+  struct {
+    milliseconds interval{0};
+    chrono::steady_clock::time_point last_time;
+    Temp last_temp{0};
+    Pwm last_pwm{0};
+  } adaptive;
+
   virtual bool set_pwm(Pwm pwm);
+  virtual bool supervise_offload() { return false; }
+  Rpm curve_rpm();
+  Pwm closest_pwm(Rpm rpm) const;
   Pwm find_closest_pwm(Rpm rpm);
   bool recover_control();
   Rpm smooth_rpm(Rpm rpm);
-  void sleep_for_interval() const;
-
-  optional<Rpm> set_stabilised_pwm(Pwm pwm);
-  bool set_pwm_test();
-  void test_stopped(Pwm_to_Rpm_Map &pwm_to_rpm);
-  void test_start(Pwm_to_Rpm_Map &pwm_to_rpm);
-  void test_interval(Pwm_to_Rpm_Map &pwm_to_rpm);
-  void test_running_min(Pwm_to_Rpm_Map &pwm_to_rpm);
-  void test_mapping(Pwm_to_Rpm_Map &pwm_to_rpm);
+  bool emergency();
+  uint64_t sample_input();
+  bool observe_rpm();
+  void rescale_rpm_to_pwm(double factor);
+  shared_ptr<fc::Sensor> control_sensor() const;
+  void adapt_interval(Pwm pwm);
+  milliseconds base_interval() const;
+  uint tuned_intervals(milliseconds time_constant) const;
+  milliseconds tick_interval() const;
+  void sleep_for_interval(uint intervals = 1) const;
+  void sleep_until_next(milliseconds period);
+  void wait_for_event(milliseconds tick);
+
+  Task<> test_sleep(milliseconds duration) const;
+  Task<> test_phases(ObservableNumber<int> &status,
+                     const function<void()> &checkpointed);
+  void save_checkpoint(uint phase, const Pwm_to_Rpm_Map &pwm_to_rpm);
+  Task<optional<Rpm>> set_stabilised_pwm(Pwm pwm);
+  Task<bool> set_pwm_test();
+  Task<> test_stopped(Pwm_to_Rpm_Map &pwm_to_rpm);
+  Task<> test_start(Pwm_to_Rpm_Map &pwm_to_rpm);
+  Task<> test_response(const Pwm_to_Rpm_Map &pwm_to_rpm);
+  Task<optional<milliseconds>> step_time_constant(Pwm from, Pwm to, Rpm to_rpm);
+  Task<> test_running_min(Pwm_to_Rpm_Map &pwm_to_rpm);
+  Task<> test_mapping(Pwm_to_Rpm_Map &pwm_to_rpm);
+  Task<bool> spot_check(const Rpm_to_Pwm_Map &expected);
 
   Percent rpm_to_percent(Rpm rpm) const;
   Rpm percent_to_rpm(Percent percent) const;
   Rpm pwm_to_rpm(Pwm pwm) const;
-  void temp_to_rpm_from(const string &src);
-  void rpm_to_pwm_from(const string &src);
+  void temp_to_rpm_from(const string &src, Temp_to_Rpm_Map &dst) const;
+  void rpm_to_pwm_from(const string &src, Rpm_to_Pwm_Map &dst) const;
   void rpm_to_pwm_from(const Pwm_to_Rpm_Map &pwm_to_rpm);
 };
 
@@ -105,4 +196,38 @@ std::ostream &operator<<(std::ostream &os, const fc::Fan &f);
 
 using FanMap = std::unordered_map<string, unique_ptr<fc::Fan>>;
 
+//----------------------//
+// TEMPLATE DEFINITIONS //
+//----------------------//
+
+template <class T>
+T fc::interpolate(const std::map<Temp, T> &curve, const Temp temp) {
+  // Lower bound is >=; Upper bound is >
+  auto floor_it = curve.lower_bound(temp); // Floor now >= temp
+
+  // temp >= max temp; use the highest value
+  if (floor_it == curve.end())
+    return next(floor_it, -1)->second;
+
+  // temp <= min temp || temp == floor temp; use the lowest value
+  if (floor_it == curve.begin() || floor_it->first == temp)
+    return floor_it->second;
+
+  // min temp < temp < max temp
+  if (floor_it->first > temp) // Make floor <= temp
+    --floor_it;
+
+  // Static; use the closest value <= temp
+  if (!fc::dynamic)
+    return floor_it->second;
+
+  // Dynamic: find the value between the floor & ceiling
+  const auto ceil_it = next(floor_it); // ceil > target
+  const T range = ceil_it->second - floor_it->second;
+
+  const double temp_range_weight =
+      static_cast<double>(temp) / (floor_it->first + ceil_it->first);
+  return floor_it->second + std::floor(temp_range_weight * range);
+}
+
 #endif // FANCON_FAN_HPP
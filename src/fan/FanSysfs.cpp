@@ -1,16 +1,19 @@
 #include "FanSysfs.hpp"
+#include "sensor/HwmonChip.hpp"
+#include "sensor/SensorSysfs.hpp"
 
-fc::FanSysfs::FanSysfs(string label_, const path &adapter_path_, SysfsID id_)
-    : Fan(move(label_)), pwm_path(get_pwm_path(adapter_path_, id_)), rpm_path(get_rpm_path(adapter_path_, id_)),
-      enable_path(get_enable_path(adapter_path_, id_)) {
-  if (is_faulty(adapter_path_, id_)) {
+fc::FanSysfs::FanSysfs(string label_, const Util::DirEntries &chip, SysfsID id_)
+    : Fan(move(label_)), pwm_path(get_pwm_path(chip, id_)), rpm_path(get_rpm_path(chip, id_)),
+      enable_path(get_enable_path(chip, id_)) {
+  uid = pwm_path.string();
+  if (is_faulty(chip, id_)) {
     LOG(llvl::warning) << *this << ": is faulty, ignoring";
     ignore = true;
     return;
   }
 
   // Enable the fan sensor
-  const auto sensor_ep = get_sensor_enable_path(adapter_path_, id_);
+  const auto sensor_ep = get_sensor_enable_path(chip, id_);
   if (sensor_ep)
     Util::write(*sensor_ep, 1);
 }
@@ -21,6 +24,10 @@ fc::FanSysfs::~FanSysfs() {
 }
 
 bool fc::FanSysfs::enable_control() {
+  // Let the chip run the curve when offloading, otherwise take manual control
+  if (offload && (offloaded = offload_control()))
+    return enabled = true;
+
   const bool success = !(exists(enable_path)) || Util::write(enable_path, manual_flag);
   if (success)
     enabled = true;
@@ -36,26 +43,36 @@ bool fc::FanSysfs::disable_control() {
   return true;
 }
 
-bool fc::FanSysfs::test(ObservableNumber<int> &status) {
+fc::Task<bool> fc::FanSysfs::test(ObservableNumber<int> &status,
+                                  function<void()> checkpointed) {
   test_driver_enable_flag();
-  return fc::Fan::test(status);
+
+  // Testing requires manual control
+  const bool offload_ = std::exchange(offload, false);
+  const bool success = co_await fc::Fan::test(status, move(checkpointed));
+  offload = offload_;
+  co_return success;
 }
 
 void fc::FanSysfs::from(const fc_pb::Fan &f, const SensorMap &sensor_map) {
   fc::Fan::from(f, sensor_map);
   pwm_path = f.pwm_path();
+  uid = pwm_path.string();
   rpm_path = f.rpm_path();
   enable_path = f.enable_path();
   driver_flag = f.driver_flag();
+  offload = f.offload();
 }
 
 void fc::FanSysfs::to(fc_pb::Fan &f) const {
   fc::Fan::to(f);
+  const lock_guard<mutex> lg(update_mutex);
   f.set_type(type());
   f.set_pwm_path(pwm_path);
   f.set_rpm_path(rpm_path);
   f.set_enable_path(enable_path);
   f.set_driver_flag(driver_flag);
+  f.set_offload(offload);
 }
 
 bool fc::FanSysfs::valid() const {
@@ -68,7 +85,11 @@ bool fc::FanSysfs::valid() const {
   return pe && re;
 }
 
-string fc::FanSysfs::hw_id() const { return pwm_path.c_str(); }
+string fc::FanSysfs::fingerprint() const {
+  // The same header (pwm index) on the same chip & board model
+  const auto chip = Util::read_line(pwm_path.parent_path() / "name");
+  return Util::dmi_id() + chip.value_or("") + "/" + pwm_path.filename().string();
+}
 
 DevType fc::FanSysfs::type() const { return DevType::SYS; }
 
@@ -90,7 +111,7 @@ Pwm fc::FanSysfs::get_pwm() const {
 }
 
 Rpm fc::FanSysfs::get_rpm() const {
-  const auto rpm = Util::read<Rpm>(rpm_path);
+  const auto rpm = HwmonChip::read(rpm_path);
   if (rpm) {
     return *rpm;
   } else {
@@ -99,6 +120,35 @@ Rpm fc::FanSysfs::get_rpm() const {
   }
 }
 
+bool fc::FanSysfs::supervise_offload() {
+  if (!offloaded)
+    return false;
+
+  // Offloading was turned off (e.g. by a patch), take manual control back
+  if (!offload) {
+    LOG(llvl::debug) << *this << ": offload disabled, using manual control";
+    offloaded = false;
+    enable_control();
+    dirty = true;
+    written_pwm.reset();
+    return false;
+  }
+
+  // Reprogram if the curve has changed, or the chip left automatic mode
+  const auto mode = Util::read<control_flag_t>(enable_path);
+  if (auto_points() != programmed_points || (mode && *mode != driver_flag)) {
+    LOG(llvl::debug) << *this << ": reprogramming auto points";
+    if (!(offloaded = offload_control())) {
+      LOG(llvl::warning) << *this << ": offload failed, using manual control";
+      enable_control();
+      dirty = true;
+      written_pwm.reset();
+    }
+  }
+
+  return offloaded;
+}
+
 void fc::FanSysfs::test_driver_enable_flag() {
   if (exists(enable_path)) {
     // 0: no fan speed control (i.e. fan at full speed)
@@ -110,26 +160,102 @@ void fc::FanSysfs::test_driver_enable_flag() {
   }
 }
 
-path fc::FanSysfs::get_pwm_path(const path &adapter_path, SysfsID dev_id) {
-  const auto p = adapter_path / path(string("pwm") + to_string(dev_id));
-  return Util::real_path(p).value_or("");
+bool fc::FanSysfs::offload_control() {
+  const auto points = auto_points();
+  const auto channel = sensor_channel();
+  if (points.empty() || !channel) {
+    LOG(llvl::warning) << *this << ": can't offload, "
+                       << Util::join({{points.empty(), "no auto points or curve"},
+                                      {!channel, "sensor isn't on the same chip"}});
+    return false;
+  }
+
+  // Bind the sensor's temperature channel, then write each point
+  const path channels_path = pwm_path.string() + "_auto_channels_temp";
+  if (exists(channels_path) && !Util::write(channels_path, 1u << (*channel - 1)))
+    return false;
+
+  for (size_t i = 0; i < points.size(); ++i) {
+    const auto &[temp, pwm] = points[i];
+    if (!Util::write(auto_point_path(i + 1, "_temp"), temp * SYSFS_TEMP_DIVISOR) ||
+        !Util::write(auto_point_path(i + 1, "_pwm"), pwm))
+      return false;
+  }
+
+  if (exists(enable_path) && !Util::write(enable_path, driver_flag))
+    return false;
+
+  programmed_points = points;
+  LOG(llvl::debug) << *this << ": offloaded " << points.size() << " points";
+  return true;
+}
+
+vector<pair<Temp, Pwm>> fc::FanSysfs::auto_points() const {
+  size_t n_points = 0;
+  while (exists(auto_point_path(n_points + 1, "_pwm")))
+    ++n_points;
+
+  // Zones are evaluated by the daemon
+  if (n_points == 0 || zone || curve->empty() || rpm_to_pwm.empty())
+    return {};
+
+  vector<pair<Temp, Pwm>> curve_points;
+  for (const auto &[temp, rpm] : *curve)
+    curve_points.emplace_back(temp, closest_pwm(rpm));
+
+  // Sample evenly if the chip has fewer points. Otherwise extra points hold the
+  // last PWM, each a degree hotter; drivers need strictly increasing temperatures
+  vector<pair<Temp, Pwm>> points;
+  const size_t n_curve = curve_points.size();
+  for (size_t i = 0; i < n_points; ++i) {
+    if (n_curve > n_points) {
+      const size_t ci = (n_points > 1) ? i * (n_curve - 1) / (n_points - 1) : n_curve - 1;
+      points.push_back(curve_points[ci]);
+    } else if (i < n_curve) {
+      points.push_back(curve_points[i]);
+    } else {
+      points.emplace_back(points.back().first + 1, points.back().second);
+    }
+  }
+
+  return points;
+}
+
+optional<SysfsID> fc::FanSysfs::sensor_channel() const {
+  if (!sensor || sensor->type() != DevType::SYS)
+    return nullopt;
+
+  // The chip can only use temperature channels of its own, e.g. temp2_input
+  fc_pb::Sensor s;
+  sensor->to(s);
+  const path input_path(s.input_path());
+  if (input_path.parent_path() != pwm_path.parent_path())
+    return nullopt;
+
+  const string name = input_path.filename().string();
+  return Util::postfix_num<SysfsID>(name.substr(0, name.find('_')));
+}
+
+path fc::FanSysfs::auto_point_path(size_t point, const string &postfix) const {
+  return pwm_path.string() + "_auto_point" + to_string(point) + postfix;
+}
+
+path fc::FanSysfs::get_pwm_path(const Util::DirEntries &chip, SysfsID dev_id) {
+  return chip.get("pwm" + to_string(dev_id)).value_or("");
 }
 
-path fc::FanSysfs::get_rpm_path(const path &adapter_path, SysfsID dev_id) {
-  const auto p = adapter_path / path("fan" + to_string(dev_id) + "_input");
-  return Util::real_path(p).value_or("");
+path fc::FanSysfs::get_rpm_path(const Util::DirEntries &chip, SysfsID dev_id) {
+  return chip.get("fan" + to_string(dev_id) + "_input").value_or("");
 }
 
-path fc::FanSysfs::get_enable_path(const path &adapter_path, SysfsID dev_id) {
-  const path p = get_pwm_path(adapter_path, dev_id).string() + "_enable";
-  return Util::real_path(p).value_or("");
+path fc::FanSysfs::get_enable_path(const Util::DirEntries &chip, SysfsID dev_id) {
+  return chip.get("pwm" + to_string(dev_id) + "_enable").value_or("");
 }
 
-optional<path> fc::FanSysfs::get_sensor_enable_path(const path &adapter_path, SysfsID dev_id) {
-  return Util::real_path(adapter_path / path("fan" + to_string(dev_id) + "_enable"));
+optional<path> fc::FanSysfs::get_sensor_enable_path(const Util::DirEntries &chip, SysfsID dev_id) {
+  return chip.get("fan" + to_string(dev_id) + "_enable");
 }
 
-bool fc::FanSysfs::is_faulty(const path &adapter_path, SysfsID dev_id) {
-  const path fault_p{adapter_path / path("fan" + to_string(dev_id) + "_fault")};
-  return Util::read<int>(fault_p).value_or(0) > 0;
+bool fc::FanSysfs::is_faulty(const Util::DirEntries &chip, SysfsID dev_id) {
+  return Util::read<int>(chip.get("fan" + to_string(dev_id) + "_fault")).value_or(0) > 0;
 }
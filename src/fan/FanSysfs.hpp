@@ -12,16 +12,17 @@ namespace fc {
 class FanSysfs : public Fan {
 public:
   FanSysfs() = default;
-  FanSysfs(string label_, const path &adapter_path_, SysfsID id_);
+  FanSysfs(string label_, const Util::DirEntries &chip, SysfsID id_);
   ~FanSysfs() override;
 
-  bool test(ObservableNumber<int> &status) override;
+  Task<bool> test(ObservableNumber<int> &status,
+                  function<void()> checkpointed) override;
   bool enable_control() override;
   bool disable_control() override;
   Pwm get_pwm() const override;
   Rpm get_rpm() const override;
   bool valid() const override;
-  string hw_id() const override;
+  string fingerprint() const override;
   virtual DevType type() const override;
 
   void from(const fc_pb::Fan &f, const SensorMap &sensor_map) override;
@@ -30,16 +31,23 @@ public:
 protected:
   path pwm_path, rpm_path, enable_path;
   control_flag_t manual_flag = 1, driver_flag = 2;
+  bool offload = false, offloaded = false;
+  vector<pair<Temp, Pwm>> programmed_points;
 
   bool set_pwm(const Pwm pwm) override;
+  bool supervise_offload() override;
   virtual void test_driver_enable_flag();
-
-  static path get_pwm_path(const path &adapter_path, SysfsID dev_id);
-  static path get_rpm_path(const path &adapter_path, SysfsID dev_id);
-  static path get_enable_path(const path &adapter_path, SysfsID dev_id);
-  static optional<path> get_sensor_enable_path(const path &adapter_path,
+  bool offload_control();
+  vector<pair<Temp, Pwm>> auto_points() const;
+  optional<SysfsID> sensor_channel() const;
+  path auto_point_path(size_t point, const string &postfix) const;
+
+  static path get_pwm_path(const Util::DirEntries &chip, SysfsID dev_id);
+  static path get_rpm_path(const Util::DirEntries &chip, SysfsID dev_id);
+  static path get_enable_path(const Util::DirEntries &chip, SysfsID dev_id);
+  static optional<path> get_sensor_enable_path(const Util::DirEntries &chip,
                                                SysfsID dev_id);
-  static bool is_faulty(const path &adapter_path, SysfsID dev_id);
+  static bool is_faulty(const Util::DirEntries &chip, SysfsID dev_id);
 };
 } // namespace fc
 
@@ -11,11 +11,18 @@ fc::FanTask::FanTask(function<void(bool &)> f)
           },
           move(f))) {}
 
-fc::FanTask::FanTask(function<void()> f,
-                     shared_ptr<ObservableNumber<int>> testing_status)
-    : test_status(move(testing_status)), t(thread(move(f))) {}
+fc::FanTask::FanTask(Task<> test,
+                     shared_ptr<ObservableNumber<int>> testing_status,
+                     function<void()> cancel_test_)
+    : test_status(move(testing_status)),
+      test_done(Executor::spawn(move(test))), cancel_test(move(cancel_test_)) {}
 
-fc::FanTask::~FanTask() { join(); }
+fc::FanTask::~FanTask() {
+  // Don't wait out the rest of a test when removed
+  if (cancel_test)
+    cancel_test();
+  join();
+}
 
 bool fc::FanTask::is_testing() const { return bool(test_status); }
 
@@ -25,10 +32,14 @@ void fc::FanTask::join() {
   if (t.joinable()) {
     t.join();
   }
+  if (test_done.valid())
+    test_done.wait();
 }
 
 fc::FanTask &fc::FanTask::operator=(fc::FanTask &&other) noexcept {
   t = move(other.t);
+  test_done = move(other.test_done);
+  cancel_test = move(other.cancel_test);
   test_status = other.test_status;
   return *this;
 }
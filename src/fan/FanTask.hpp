@@ -1,6 +1,7 @@
 #ifndef FANCON_SRC_FANTHREAD_HPP
 #define FANCON_SRC_FANTHREAD_HPP
 
+#include "util/Executor.hpp"
 #include "util/Util.hpp"
 #include "boost/thread.hpp"
 
@@ -11,8 +12,9 @@ namespace fc {
 class FanTask {
 public:
   explicit FanTask(function<void(bool &)> f);
-  explicit FanTask(function<void()> f,
-                   shared_ptr<ObservableNumber<int>> testing_status);
+  explicit FanTask(Task<> test,
+                   shared_ptr<ObservableNumber<int>> testing_status,
+                   function<void()> cancel_test);
   ~FanTask();
 
   shared_ptr<ObservableNumber<int>> test_status = nullptr;
@@ -25,6 +27,8 @@ public:
 private:
   bool run = true;
   thread t;
+  std::shared_future<void> test_done; // Tests run on the Executor
+  function<void()> cancel_test;       // Stops a removed test at its next checkpoint
 };
 } // namespace fc
 
@@ -4,7 +4,9 @@
 
 using fc::NV::xnvlib;
 
-fc::FanNV::FanNV(string label, NVID id) : Fan(move(label)), id(id) {}
+fc::FanNV::FanNV(string label, NVID id) : Fan(move(label)), id(id) {
+  uid = string("NV:f") + to_string(id);
+}
 
 fc::FanNV::~FanNV() {
   if (enabled)
@@ -14,6 +16,7 @@ fc::FanNV::~FanNV() {
 void fc::FanNV::from(const fc_pb::Fan &f, const SensorMap &sensor_map) {
   fc::Fan::from(f, sensor_map);
   id = f.id();
+  uid = string("NV:f") + to_string(id);
 }
 
 void fc::FanNV::to(fc_pb::Fan &f) const {
@@ -26,7 +29,30 @@ bool fc::FanNV::valid() const {
   return xnvlib->pwm_percent.read(id).has_value();
 }
 
-string fc::FanNV::hw_id() const { return string("NV:f") + to_string(id); }
+string fc::FanNV::fingerprint() const {
+  // The GPU model's PCI ID, and the cooler's index on it
+  for (int gpu = 0, n_gpus = xnvlib->get_num_GPUs(); gpu < n_gpus; ++gpu) {
+    unsigned char *buf = nullptr;
+    int len{}, pci_id{};
+    if (!xnvlib->QueryTargetBinaryData(*xnvlib->xdisplay, NV_CTRL_TARGET_TYPE_GPU,
+                                       gpu, 0, NV_CTRL_BINARY_DATA_COOLERS_USED_BY_GPU,
+                                       &buf, &len) ||
+        buf == nullptr)
+      continue;
+
+    const vector<NVID> fan_ids = NV::LibXNvCtrl::from_binary_data(buf, len);
+    const auto it = std::find(fan_ids.begin(), fan_ids.end(), id);
+    if (it != fan_ids.end() &&
+        xnvlib->QueryTargetAttribute(*xnvlib->xdisplay, NV_CTRL_TARGET_TYPE_GPU,
+                                     gpu, 0, NV_CTRL_PCI_ID, &pci_id)) {
+      std::stringstream ss;
+      ss << "NV:" << std::hex << pci_id << "/" << (it - fan_ids.begin());
+      return ss.str();
+    }
+  }
+
+  return hw_id();
+}
 
 DevType fc::FanNV::type() const { return DevType::NVIDIA; }
 
@@ -102,24 +128,27 @@ Pwm fc::FanNV::percent_to_pwm(const Percent percent) {
 }
 
 fc::SensorNV::SensorNV(string label, NVID id)
-    : Sensor(move(label)), id(id) {}
+    : Sensor(move(label)), id(id) {
+  uid = string("NV:s") + to_string(id);
+}
 
 optional<Temp> fc::SensorNV::read() const { return xnvlib->temp.read(id); }
 
 void fc::SensorNV::from(const fc_pb::Sensor &s) {
   fc::Sensor::from(s);
   id = s.id();
+  uid = string("NV:s") + to_string(id);
 }
 
 void fc::SensorNV::to(fc_pb::Sensor &s) const {
   fc::Sensor::to(s);
-  s.set_type(fc_pb::NVIDIA);
+  s.set_type(type());
   s.set_id(id);
 }
 
 bool fc::SensorNV::valid() const { return xnvlib->temp.read(id).has_value(); }
 
-string fc::SensorNV::hw_id() const { return string("NV:s") + to_string(id); }
+DevType fc::SensorNV::type() const { return DevType::NVIDIA; }
 
 void fc::SensorNV::enumerate(SensorMap &sensors) {
   NV::init();
@@ -18,7 +18,7 @@ public:
   Pwm get_pwm() const override;
   Rpm get_rpm() const override;
   bool valid() const override;
-  string hw_id() const override;
+  string fingerprint() const override;
   virtual DevType type() const override;
 
   void from(const fc_pb::Fan &f, const SensorMap &sensor_map) override;
@@ -45,7 +45,7 @@ public:
   void from(const fc_pb::Sensor &s) override;
   void to(fc_pb::Sensor &s) const override;
   bool valid() const override;
-  string hw_id() const override;
+  DevType type() const override;
 
   static void enumerate(SensorMap &sensors);
 
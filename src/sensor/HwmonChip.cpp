@@ -0,0 +1,214 @@
+#include "HwmonChip.hpp"
+
+namespace fc {
+mutex HwmonChip::chips_mutex;
+std::unordered_map<string, shared_ptr<HwmonChip::Chip>> HwmonChip::chips;
+} // namespace fc
+
+fc::HwmonChip::Chip::~Chip() {
+#ifdef FANCON_IO_URING_SUPPORT
+  if (ring)
+    io_uring_queue_exit(&*ring);
+#endif // FANCON_IO_URING_SUPPORT
+
+  for (const auto &a : attrs) {
+    if (a.fd >= 0)
+      close(a.fd);
+  }
+}
+
+optional<long> fc::HwmonChip::read(const path &attr) {
+  const auto c = chip(attr.parent_path());
+  const lock_guard<mutex> lg(c->burst_mutex);
+
+  // Descriptors are kept open; re-reading from offset 0 refreshes the value
+  auto [it, added] = c->attr_index.try_emplace(attr.string(), c->attrs.size());
+  if (added) {
+    c->attrs.push_back({attr, open(attr.c_str(), O_RDONLY | O_CLOEXEC), nullopt});
+#ifdef FANCON_IO_URING_SUPPORT
+    c->registered = false;
+#endif // FANCON_IO_URING_SUPPORT
+  }
+
+  Attr &a = c->attrs[it->second];
+  if (c->update_interval.count() <= 0 || added) // New attributes join the next burst
+    return a.value = read(*c, a);
+
+  // Re-read every attribute of the chip once its values may have changed
+  const auto now = chrono::steady_clock::now();
+  if (now - c->last_burst >= c->update_interval) {
+    burst(*c);
+    c->last_burst = now;
+  }
+
+  return a.value;
+}
+
+void fc::HwmonChip::forget(const path &dir) {
+  // The chip was removed or its driver reloaded; its descriptors are stale
+  const lock_guard<mutex> lg(chips_mutex);
+  chips.erase(dir.string());
+}
+
+shared_ptr<fc::HwmonChip::Chip> fc::HwmonChip::chip(const path &dir) {
+  const lock_guard<mutex> lg(chips_mutex);
+  auto &c = chips[dir.string()];
+  if (!c) {
+    c = make_shared<Chip>();
+    if (const auto ms = Util::read<long>(dir / "update_interval"); ms && *ms > 0) {
+      c->update_interval = milliseconds(*ms);
+      LOG(llvl::debug) << dir.string() << ": update interval " << *ms << "ms";
+    }
+  }
+
+  return c;
+}
+
+void fc::HwmonChip::burst(Chip &c) {
+#ifdef FANCON_IO_URING_SUPPORT
+  const bool batched = burst_uring(c);
+#else
+  const bool batched = false;
+#endif // FANCON_IO_URING_SUPPORT
+
+  for (auto &a : c.attrs) {
+    if (!batched || !a.fixed)
+      a.value = read(c, a);
+  }
+}
+
+optional<long> fc::HwmonChip::read([[maybe_unused]] Chip &c, Attr &a) {
+  if (a.fd < 0) { // Attribute may appear later, e.g. once a driver is loaded
+    a.fd = open(a.p.c_str(), O_RDONLY | O_CLOEXEC);
+    if (a.fd < 0)
+      return nullopt;
+#ifdef FANCON_IO_URING_SUPPORT
+    c.registered = false;
+#endif // FANCON_IO_URING_SUPPORT
+  }
+
+  char buf[VALUE_BUF_SIZE];
+  ssize_t len = pread(a.fd, buf, sizeof(buf), 0);
+  if (len < 0) {
+    // The descriptor goes stale if the driver was reloaded, so reopen once
+    close(a.fd);
+    a.fd = open(a.p.c_str(), O_RDONLY | O_CLOEXEC);
+#ifdef FANCON_IO_URING_SUPPORT
+    c.registered = false;
+#endif // FANCON_IO_URING_SUPPORT
+    if (a.fd < 0)
+      return nullopt;
+
+    len = pread(a.fd, buf, sizeof(buf), 0);
+  }
+
+  return parse(buf, len);
+}
+
+optional<long> fc::HwmonChip::parse(const char *buf, ssize_t len) {
+  long v;
+  if (len <= 0 || std::from_chars(buf, buf + len, v).ec != std::errc())
+    return nullopt;
+
+  return v;
+}
+
+#ifdef FANCON_IO_URING_SUPPORT
+bool fc::HwmonChip::burst_uring(Chip &c) {
+  // One submission reads every attribute, into buffers registered up front
+  if (c.ring_failed || (!c.registered && !register_uring(c)))
+    return false;
+
+  io_uring &ring = *c.ring;
+  for (size_t i = 0; i < c.registered_attrs.size(); ++i) {
+    io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_read_fixed(sqe, i, c.bufs[i].data(), VALUE_BUF_SIZE, 0, i);
+    sqe->flags |= IOSQE_FIXED_FILE;
+    io_uring_sqe_set_data64(sqe, i);
+  }
+
+  const auto n = c.registered_attrs.size();
+  if (io_uring_submit_and_wait(&ring, n) < 0) {
+    reset_uring(c);
+    return false;
+  }
+
+  bool stale = false;
+  for (size_t done = 0; done < n; ++done) {
+    io_uring_cqe *cqe;
+    if (io_uring_wait_cqe(&ring, &cqe) < 0) {
+      // Completions may still be in flight; start afresh with a new ring
+      reset_uring(c);
+      return false;
+    }
+
+    const auto i = io_uring_cqe_get_data64(cqe);
+    Attr &a = c.attrs[c.registered_attrs[i]];
+    if (cqe->res < 0) { // Stale descriptor, read (& reopen) it with a syscall
+      a.fixed = false;
+      stale = true;
+    } else {
+      a.value = parse(c.bufs[i].data(), cqe->res);
+    }
+    io_uring_cqe_seen(&ring, cqe);
+  }
+
+  if (stale)
+    c.registered = false;
+
+  return true;
+}
+
+void fc::HwmonChip::reset_uring(Chip &c) {
+  // Dropping the ring discards any unreaped completions; it is rebuilt next burst
+  if (c.ring)
+    io_uring_queue_exit(&*c.ring);
+  c.ring.reset();
+  c.registered = false;
+  for (auto &a : c.attrs)
+    a.fixed = false;
+}
+
+bool fc::HwmonChip::register_uring(Chip &c) {
+  if (!c.ring) {
+    c.ring.emplace();
+    if (const int res = io_uring_queue_init(URING_DEPTH, &*c.ring, 0); res < 0) {
+      LOG(llvl::debug) << "io_uring unavailable (" << strerror(-res)
+                       << "), using read syscalls";
+      c.ring.reset();
+      c.ring_failed = true;
+      return false;
+    }
+  } else {
+    io_uring_unregister_files(&*c.ring);
+    io_uring_unregister_buffers(&*c.ring);
+  }
+
+  // Register open attributes as fixed files, each with a fixed buffer
+  vector<int> fds;
+  c.registered_attrs.clear();
+  for (size_t i = 0; i < c.attrs.size(); ++i) {
+    auto &a = c.attrs[i];
+    a.fixed = a.fd >= 0 && fds.size() < URING_DEPTH;
+    if (a.fixed) {
+      fds.push_back(a.fd);
+      c.registered_attrs.push_back(i);
+    }
+  }
+
+  c.bufs.resize(fds.size());
+  vector<iovec> iovecs;
+  for (auto &b : c.bufs)
+    iovecs.push_back({b.data(), b.size()});
+
+  c.registered = !fds.empty() &&
+                 io_uring_register_files(&*c.ring, fds.data(), fds.size()) == 0 &&
+                 io_uring_register_buffers(&*c.ring, iovecs.data(), iovecs.size()) == 0;
+  if (!c.registered) {
+    for (auto &a : c.attrs)
+      a.fixed = false;
+  }
+
+  return c.registered;
+}
+#endif // FANCON_IO_URING_SUPPORT
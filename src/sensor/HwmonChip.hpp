@@ -0,0 +1,65 @@
+#ifndef FANCON_HWMONCHIP_HPP
+#define FANCON_HWMONCHIP_HPP
+
+#include <array>
+#include <fcntl.h>
+#include <unordered_map>
+
+#ifdef FANCON_IO_URING_SUPPORT
+#include <liburing.h>
+#endif // FANCON_IO_URING_SUPPORT
+
+#include "util/Util.hpp"
+
+namespace fc {
+// Reads all of a chip's attributes in one burst, at most once per its
+// update_interval; drivers cache registers for that long, so reading any
+// sooner only returns stale values (or triggers slow bus transactions)
+// https://www.kernel.org/doc/Documentation/hwmon/sysfs-interface
+class HwmonChip {
+public:
+  static optional<long> read(const path &attr);
+  static void forget(const path &dir);
+
+private:
+  static constexpr size_t VALUE_BUF_SIZE = 32, URING_DEPTH = 64;
+
+  struct Attr {
+    path p;
+    int fd = -1;
+    optional<long> value;
+    bool fixed = false; // Registered with the chip's io_uring
+  };
+
+  struct Chip {
+    ~Chip();
+
+    mutex burst_mutex;
+    milliseconds update_interval{0};
+    chrono::steady_clock::time_point last_burst;
+    vector<Attr> attrs;
+    std::unordered_map<string, size_t> attr_index;
+#ifdef FANCON_IO_URING_SUPPORT
+    optional<io_uring> ring;
+    bool ring_failed = false, registered = false;
+    vector<size_t> registered_attrs; // Fixed file & buffer index to attr
+    vector<std::array<char, VALUE_BUF_SIZE>> bufs;
+#endif // FANCON_IO_URING_SUPPORT
+  };
+
+  static mutex chips_mutex;
+  static std::unordered_map<string, shared_ptr<Chip>> chips;
+
+  static shared_ptr<Chip> chip(const path &dir);
+  static void burst(Chip &c);
+  static optional<long> read(Chip &c, Attr &a);
+  static optional<long> parse(const char *buf, ssize_t len);
+#ifdef FANCON_IO_URING_SUPPORT
+  static bool burst_uring(Chip &c);
+  static bool register_uring(Chip &c);
+  static void reset_uring(Chip &c);
+#endif // FANCON_IO_URING_SUPPORT
+};
+} // namespace fc
+
+#endif // FANCON_HWMONCHIP_HPP
@@ -7,29 +7,55 @@ Temp fc::Sensor::get_average_temp() {
   if (fresh())
     return last_avg_temp;
 
-  const auto temp = read();
-  if (temp) {
-    if (!temp_history.empty()) {
-      temp_history[temp_history_i] = *temp;
-      temp_history_i = (temp_history_i < temp_history.size()) ? temp_history_i + 1 : 0;
-    } else {
-      temp_history.resize(fc::temp_averaging_intervals, *temp);
+  if (!filter)
+    filter = make_filter();
+
+  if (const auto temp = read(); temp) {
+    if (const Temp avg = filter->update(*temp); avg != last_avg_temp) {
+      last_avg_temp = avg;
+      ++version;
     }
-  } else {
+  } else
     LOG(llvl::error) << *this << ": failed to read";
-  }
 
   last_read_time = chrono::high_resolution_clock::now();
-  last_avg_temp = std::accumulate(temp_history.begin(), temp_history.end(), 0) / temp_history.size();
 
   LOG(llvl::trace) << *this << ": " << last_avg_temp << "°" << fc::log::flush;
 
   return last_avg_temp;
 }
 
-void fc::Sensor::from(const fc_pb::Sensor &s) { label = s.label(); }
+optional<Temp> fc::Sensor::critical_temp() {
+  // Limits don't change at runtime, so are only read once
+  std::scoped_lock lock(read_mutex);
+  if (!crit_temp_read) {
+    crit_temp = max_temp();
+    crit_temp_read = true;
+  }
+
+  return crit_temp;
+}
+
+void fc::Sensor::patch(const fc_pb::Sensor &s) {
+  std::scoped_lock lock(read_mutex);
+  from(s);
+}
 
-void fc::Sensor::to(fc_pb::Sensor &s) const { s.set_label(label); }
+void fc::Sensor::from(const fc_pb::Sensor &s) {
+  label = s.label();
+  ignore = s.ignore();
+  filter_conf = s.filter();
+  filter.reset();
+  ++version;
+  crit_temp_read = false;
+}
+
+void fc::Sensor::to(fc_pb::Sensor &s) const {
+  s.set_label(label);
+  s.set_ignore(ignore);
+  if (filter_conf.ByteSizeLong() > 0)
+    *s.mutable_filter() = filter_conf;
+}
 
 bool fc::Sensor::deep_equal(const Sensor &other) const {
   fc_pb::Sensor s, sother;
@@ -38,6 +64,10 @@ bool fc::Sensor::deep_equal(const Sensor &other) const {
   return Util::deep_equal(s, sother);
 }
 
+unique_ptr<fc::TempFilter> fc::Sensor::make_filter() const {
+  return TempFilter::make(filter_conf);
+}
+
 bool fc::Sensor::fresh() const {
   const auto dur = chrono::duration_cast<milliseconds>(chrono::high_resolution_clock::now() - last_read_time);
   return dur <= milliseconds(200);
@@ -4,14 +4,19 @@
 #include <mutex>
 #include <numeric>
 
+#include "TempFilter.hpp"
 #include "util/Util.hpp"
 #include "proto/DevicesSpec.pb.h"
 
-using Temp = int;
+using fc_pb::DevType;
 
 namespace fc {
-extern uint temp_averaging_intervals;
+class Sensor;
+}
 
+using SensorMap = std::unordered_map<string, shared_ptr<fc::Sensor>>;
+
+namespace fc {
 class Sensor {
 public:
   Sensor() = default;
@@ -22,31 +27,39 @@ public:
   bool ignore{false};
 
   Temp get_average_temp();
+  uint64_t get_version() const { return version; }
+  optional<Temp> critical_temp();
+  void patch(const fc_pb::Sensor &s);
   virtual optional<Temp> min_temp() const { return nullopt; }
   virtual optional<Temp> max_temp() const { return nullopt; }
 
   virtual void from(const fc_pb::Sensor &s);
   virtual void to(fc_pb::Sensor &s) const;
   virtual bool valid() const = 0;
-  virtual string hw_id() const = 0;
+  const string &hw_id() const { return uid; }
+  virtual DevType type() const = 0;
+  virtual void link([[maybe_unused]] const SensorMap &sensor_map) {}
 
   bool deep_equal(const Sensor &other) const;
   friend std::ostream &operator<<(std::ostream &os, const Sensor &s);
 
 protected:
+  string uid; // hw_id, precomputed whenever the device's paths or id change
   std::mutex read_mutex;
   chrono::high_resolution_clock::time_point last_read_time;
-  vector<Temp> temp_history;
-  size_t temp_history_i = 0;
+  fc_pb::TempFilter filter_conf;
+  unique_ptr<TempFilter> filter;
   Temp last_avg_temp = 0;
+  std::atomic<uint64_t> version{0}; // Bumped when the filtered temp changes
+  optional<Temp> crit_temp;
+  bool crit_temp_read = false;
 
   virtual optional<Temp> read() const = 0;
+  virtual unique_ptr<TempFilter> make_filter() const;
   bool fresh() const;
 };
 
 std::ostream &operator<<(std::ostream &os, const Sensor &s);
 } // namespace fc
 
-using SensorMap = std::unordered_map<string, shared_ptr<fc::Sensor>>;
-
 #endif // FANCON_SENSOR_HPP
@@ -1,10 +1,11 @@
 #include "SensorSysfs.hpp"
 
-fc::SensorSysfs::SensorSysfs(string label_, const string &dev_path)
-    : fc::Sensor(move(label_)), input_path(real_path(dev_path + "_input")),
-      enable_path(real_path(dev_path + "_enable")), fault_path(real_path(dev_path + "_fault")),
-      min_path(real_path(dev_path + "_min")), max_path(real_path(dev_path + "_max")),
-      crit_path(real_path(dev_path + "_crit")) {
+fc::SensorSysfs::SensorSysfs(string label_, const Util::DirEntries &chip, const string &feature)
+    : fc::Sensor(move(label_)), input_path(chip.get(feature + "_input")),
+      enable_path(chip.get(feature + "_enable")), fault_path(chip.get(feature + "_fault")),
+      min_path(chip.get(feature + "_min")), max_path(chip.get(feature + "_max")),
+      crit_path(chip.get(feature + "_crit")) {
+  uid = input_path.value_or("").string();
   if (is_faulty()) {
     LOG(llvl::warning) << *this << ": is faulty, ignoring";
     ignore = true;
@@ -36,13 +37,12 @@ bool fc::SensorSysfs::valid() const {
   return input_path && exists(*input_path);
 }
 
-string fc::SensorSysfs::hw_id() const {
-  return input_path->string();
-}
+DevType fc::SensorSysfs::type() const { return DevType::SYS; }
 
 void fc::SensorSysfs::from(const fc_pb::Sensor &s) {
   fc::Sensor::from(s);
   input_path = path(s.input_path());
+  uid = input_path->string();
   enable_path = path(s.enable_path());
   fault_path = path(s.fault_path());
   min_path = path(s.min_path());
@@ -53,7 +53,7 @@ void fc::SensorSysfs::from(const fc_pb::Sensor &s) {
 void fc::SensorSysfs::to(fc_pb::Sensor &s) const {
   fc::Sensor::to(s);
 
-  s.set_type(fc_pb::SYS);
+  s.set_type(type());
   if (input_path)
     s.set_input_path(input_path->string());
   if (enable_path)
@@ -69,8 +69,8 @@ void fc::SensorSysfs::to(fc_pb::Sensor &s) const {
 }
 
 optional<Temp> fc::SensorSysfs::read() const {
-  const auto temp = Util::read<Temp>(input_path);
-  return (temp) ? optional(*temp / SYSFS_TEMP_DIVISOR) : nullopt;
+  const auto temp = (input_path) ? HwmonChip::read(*input_path) : nullopt;
+  return (temp) ? optional(Temp(*temp / SYSFS_TEMP_DIVISOR)) : nullopt;
 }
 
 bool fc::SensorSysfs::enable() const {
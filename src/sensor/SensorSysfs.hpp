@@ -3,6 +3,7 @@
 
 #include <algorithm>
 
+#include "HwmonChip.hpp"
 #include "Sensor.hpp"
 
 using fc::Util::real_path;
@@ -16,12 +17,12 @@ static const Temp SYSFS_TEMP_DIVISOR = 1000;
 class SensorSysfs : public Sensor {
 public:
   SensorSysfs() = default;
-  SensorSysfs(string label_, const string &dev_path);
+  SensorSysfs(string label_, const Util::DirEntries &chip, const string &feature);
 
   optional<Temp> min_temp() const override;
   optional<Temp> max_temp() const override;
   bool valid() const override;
-  string hw_id() const override;
+  DevType type() const override;
 
   void from(const fc_pb::Sensor &s) override;
   void to(fc_pb::Sensor &s) const override;
@@ -0,0 +1,271 @@
+#include "SensorVirtual.hpp"
+
+namespace {
+void skip_space(string_view &s) {
+  while (!s.empty() && std::isspace(s.front()))
+    s.remove_prefix(1);
+}
+
+bool consume(string_view &s, char c) {
+  skip_space(s);
+  if (s.empty() || s.front() != c)
+    return false;
+
+  s.remove_prefix(1);
+  return true;
+}
+
+// Labels may contain '-' & '/', e.g. hwmon3/temp-1, so those operators need
+// spaces around bare labels
+bool is_label_char(char c) {
+  return std::isalnum(c) || c == '_' || c == '.' || c == '/' || c == '-';
+}
+} // namespace
+
+bool fc::SensorVirtual::valid() const { return compiled; }
+
+DevType fc::SensorVirtual::type() const { return DevType::VIRTUAL; }
+
+void fc::SensorVirtual::link(const SensorMap &sensor_map) {
+  // Inputs must be real sensors, so an expression can't depend on itself
+  vector<shared_ptr<Sensor>> linked;
+  for (const auto &l : input_labels) {
+    const auto it = sensor_map.find(l);
+    if (it == sensor_map.end() || it->second->type() == DevType::VIRTUAL) {
+      LOG(llvl::error) << *this << ": input '" << l << "' "
+                       << ((it == sensor_map.end()) ? "not found" : "is virtual");
+      linked.clear();
+      break;
+    }
+    linked.push_back(it->second);
+  }
+
+  const std::scoped_lock lock(read_mutex);
+  inputs = move(linked);
+}
+
+void fc::SensorVirtual::from(const fc_pb::Sensor &s) {
+  fc::Sensor::from(s);
+  uid = "virtual/" + label;
+  expression = s.expression();
+  compiled = compile();
+  inputs.clear();
+}
+
+void fc::SensorVirtual::to(fc_pb::Sensor &s) const {
+  fc::Sensor::to(s);
+  s.set_type(type());
+  s.set_expression(expression);
+}
+
+optional<Temp> fc::SensorVirtual::read() const {
+  // A failed compile may leave a partial program
+  if (!compiled || (inputs.empty() && !input_labels.empty()))
+    return nullopt;
+
+  // Evaluate the postfix program; inputs cache their reading for the tick
+  vector<double> stack;
+  stack.reserve(program.size());
+  const auto pop = [&] {
+    const double v = stack.back();
+    stack.pop_back();
+    return v;
+  };
+
+  for (const Op &op : program) {
+    switch (op.code) {
+    case Op::CONST:
+      stack.push_back(op.value);
+      break;
+    case Op::INPUT:
+      stack.push_back(inputs[op.arg]->get_average_temp());
+      break;
+    case Op::NEG:
+      stack.back() = -stack.back();
+      break;
+    case Op::MAX:
+    case Op::MIN:
+    case Op::AVG: {
+      const auto first = stack.end() - op.arg;
+      const double v = (op.code == Op::MAX) ? *std::max_element(first, stack.end())
+                       : (op.code == Op::MIN)
+                           ? *std::min_element(first, stack.end())
+                           : std::accumulate(first, stack.end(), 0.0) / op.arg;
+      stack.erase(first, stack.end());
+      stack.push_back(v);
+      break;
+    }
+    default: {
+      const double r = pop(), l = pop();
+      stack.push_back((op.code == Op::ADD)   ? l + r
+                      : (op.code == Op::SUB) ? l - r
+                      : (op.code == Op::MUL) ? l * r
+                      : (r != 0)             ? l / r
+                                             : 0);
+    }
+    }
+  }
+
+  return Temp(std::lround(stack.back()));
+}
+
+unique_ptr<fc::TempFilter> fc::SensorVirtual::make_filter() const {
+  // Inputs are already filtered, so don't average again unless configured
+  return (filter_conf.ByteSizeLong() > 0) ? TempFilter::make(filter_conf)
+                                          : make_unique<MovingAverageFilter>(1);
+}
+
+bool fc::SensorVirtual::compile() {
+  program.clear();
+  input_labels.clear();
+
+  string_view s(expression);
+  const bool parsed = parse_sum(s);
+  skip_space(s);
+  if (!parsed || !s.empty()) {
+    LOG(llvl::error) << *this << ": invalid expression at '" << s << "' in '"
+                     << expression << "'";
+    return false;
+  }
+
+  // Every op must find its operands, leaving exactly the result
+  size_t depth = 0;
+  for (const Op &op : program) {
+    const size_t operands = (op.code == Op::CONST || op.code == Op::INPUT) ? 0
+                            : (op.code == Op::NEG)                         ? 1
+                            : (op.code == Op::MAX || op.code == Op::MIN ||
+                               op.code == Op::AVG)
+                                ? op.arg
+                                : 2;
+    if (depth < operands) {
+      depth = 0;
+      break;
+    }
+    depth = depth - operands + 1;
+  }
+
+  if (depth != 1) {
+    LOG(llvl::error) << *this << ": invalid expression '" << expression << "'";
+    return false;
+  }
+
+  return true;
+}
+
+bool fc::SensorVirtual::parse_sum(string_view &s) {
+  if (!parse_product(s))
+    return false;
+
+  for (;;) {
+    if (consume(s, '+')) {
+      if (!parse_product(s))
+        return false;
+      program.push_back({Op::ADD});
+    } else if (consume(s, '-')) {
+      if (!parse_product(s))
+        return false;
+      program.push_back({Op::SUB});
+    } else {
+      return true;
+    }
+  }
+}
+
+bool fc::SensorVirtual::parse_product(string_view &s) {
+  if (!parse_factor(s))
+    return false;
+
+  for (;;) {
+    if (consume(s, '*')) {
+      if (!parse_factor(s))
+        return false;
+      program.push_back({Op::MUL});
+    } else if (consume(s, '/')) {
+      if (!parse_factor(s))
+        return false;
+      program.push_back({Op::DIV});
+    } else {
+      return true;
+    }
+  }
+}
+
+bool fc::SensorVirtual::parse_factor(string_view &s) {
+  skip_space(s);
+  if (s.empty())
+    return false;
+
+  if (consume(s, '-')) {
+    if (!parse_factor(s))
+      return false;
+    program.push_back({Op::NEG});
+    return true;
+  }
+
+  if (consume(s, '('))
+    return parse_sum(s) && consume(s, ')');
+
+  // Number
+  if (std::isdigit(s.front()) || s.front() == '.') {
+    double v;
+    const auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (ec != std::errc())
+      return false;
+
+    program.push_back({Op::CONST, v});
+    s.remove_prefix(p - s.data());
+    return true;
+  }
+
+  // Quoted label, for labels with spaces
+  if (consume(s, '\'')) {
+    const auto end = s.find('\'');
+    if (end == string_view::npos)
+      return false;
+
+    program.push_back({Op::INPUT, 0, input_index(string(s.substr(0, end)))});
+    s.remove_prefix(end + 1);
+    return true;
+  }
+
+  size_t len = 0;
+  while (len < s.size() && is_label_char(s[len]))
+    ++len;
+  if (len == 0)
+    return false;
+
+  const string name(s.substr(0, len));
+  s.remove_prefix(len);
+
+  // Function of one or more arguments
+  if (consume(s, '(')) {
+    const Op::Code code = (name == "max")   ? Op::MAX
+                          : (name == "min") ? Op::MIN
+                          : (name == "avg") ? Op::AVG
+                                            : Op::CONST;
+    if (code == Op::CONST)
+      return false;
+
+    size_t args = 0;
+    do {
+      if (!parse_sum(s))
+        return false;
+      ++args;
+    } while (consume(s, ','));
+
+    program.push_back({code, 0, args});
+    return consume(s, ')');
+  }
+
+  program.push_back({Op::INPUT, 0, input_index(name)});
+  return true;
+}
+
+size_t fc::SensorVirtual::input_index(const string &input_label) {
+  const auto it = std::find(input_labels.begin(), input_labels.end(), input_label);
+  if (it != input_labels.end())
+    return it - input_labels.begin();
+
+  input_labels.push_back(input_label);
+  return input_labels.size() - 1;
+}
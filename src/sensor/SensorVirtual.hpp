@@ -0,0 +1,44 @@
+#ifndef FANCON_SENSORVIRTUAL_HPP
+#define FANCON_SENSORVIRTUAL_HPP
+
+#include "Sensor.hpp"
+
+namespace fc {
+// Computed from other sensors by an expression, e.g.
+// "max('CPU 0', 'CPU 1', NVMe)", "0.7 * CPU + 0.3 * GPU", "CPU - Ambient"
+class SensorVirtual : public Sensor {
+public:
+  SensorVirtual() = default;
+
+  bool valid() const override;
+  DevType type() const override;
+  void link(const SensorMap &sensor_map) override;
+
+  void from(const fc_pb::Sensor &s) override;
+  void to(fc_pb::Sensor &s) const override;
+
+private:
+  struct Op {
+    enum Code { CONST, INPUT, ADD, SUB, MUL, DIV, NEG, MAX, MIN, AVG } code;
+    double value = 0;
+    size_t arg = 0; // Input index, or argument count of MAX, MIN & AVG
+  };
+
+  string expression;
+  vector<Op> program;
+  vector<string> input_labels;
+  vector<shared_ptr<Sensor>> inputs;
+  bool compiled = false;
+
+  optional<Temp> read() const override;
+  unique_ptr<TempFilter> make_filter() const override;
+
+  bool compile();
+  bool parse_sum(string_view &s);
+  bool parse_product(string_view &s);
+  bool parse_factor(string_view &s);
+  size_t input_index(const string &input_label);
+};
+} // namespace fc
+
+#endif // FANCON_SENSORVIRTUAL_HPP
@@ -0,0 +1,89 @@
+#include "TempFilter.hpp"
+
+unique_ptr<fc::TempFilter> fc::TempFilter::make(const fc_pb::TempFilter &f) {
+  const size_t window =
+      (f.window() > 0) ? f.window() : std::max(fc::temp_averaging_intervals, 1u);
+
+  switch (f.type()) {
+  case fc_pb::TempFilter_Type_EWMA:
+    return make_unique<EwmaFilter>((f.alpha() > 0 && f.alpha() <= 1) ? f.alpha()
+                                                                     : 2.0 / (window + 1));
+  case fc_pb::TempFilter_Type_MEDIAN:
+    return make_unique<MedianFilter>(window);
+  case fc_pb::TempFilter_Type_KALMAN:
+    return make_unique<KalmanFilter>((f.process_noise() > 0) ? f.process_noise() : 0.05,
+                                     (f.measurement_noise() > 0) ? f.measurement_noise() : 1.0);
+  default:
+    return make_unique<MovingAverageFilter>(window);
+  }
+}
+
+fc::MovingAverageFilter::MovingAverageFilter(size_t window_) : ring(window_) {}
+
+Temp fc::MovingAverageFilter::update(Temp temp) {
+  // Keep a running sum, swapping the oldest reading for the newest
+  sum += temp - ring[ring_i];
+  ring[ring_i] = temp;
+  ring_i = (ring_i + 1) % ring.size();
+  filled = std::min(filled + 1, ring.size());
+  return sum / long(filled);
+}
+
+fc::EwmaFilter::EwmaFilter(double alpha_) : alpha(alpha_) {}
+
+Temp fc::EwmaFilter::update(Temp temp) {
+  avg = (avg) ? alpha * temp + (1 - alpha) * *avg : temp;
+  return std::lround(*avg);
+}
+
+fc::MedianFilter::MedianFilter(size_t window_) : window(window_) {}
+
+Temp fc::MedianFilter::update(Temp temp) {
+  // mid steps toward whichever side of it grew; equal readings insert after it
+  order.push_back(temp);
+  const auto it = sorted.insert(temp);
+  if (sorted.size() == 1)
+    mid = it;
+  else if (temp < *mid && sorted.size() % 2 == 1)
+    --mid;
+  else if (temp >= *mid && sorted.size() % 2 == 0)
+    ++mid;
+
+  if (order.size() > window) {
+    const Temp oldest = order.front();
+    order.pop_front();
+
+    const bool odd = sorted.size() % 2 == 1;
+    if (oldest == *mid) {
+      // Equal readings are interchangeable, so drop mid itself
+      const auto erased = mid;
+      mid = (odd) ? next(mid) : prev(mid);
+      sorted.erase(erased);
+    } else {
+      sorted.erase(sorted.find(oldest));
+      if (oldest < *mid && odd)
+        ++mid;
+      else if (oldest > *mid && !odd)
+        --mid;
+    }
+  }
+
+  return *mid;
+}
+
+fc::KalmanFilter::KalmanFilter(double process_noise_, double measurement_noise_)
+    : process_noise(process_noise_), measurement_noise(measurement_noise_) {}
+
+Temp fc::KalmanFilter::update(Temp temp) {
+  // Constant temperature model; the gain weighs the estimate against the reading
+  if (!estimate) {
+    estimate = temp;
+    return temp;
+  }
+
+  error += process_noise;
+  const double gain = error / (error + measurement_noise);
+  *estimate += gain * (temp - *estimate);
+  error *= 1 - gain;
+  return std::lround(*estimate);
+}
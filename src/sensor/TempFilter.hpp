@@ -0,0 +1,74 @@
+#ifndef FANCON_TEMPFILTER_HPP
+#define FANCON_TEMPFILTER_HPP
+
+#include <deque>
+
+#include "util/Util.hpp"
+#include "proto/DevicesSpec.pb.h"
+
+using Temp = int;
+
+namespace fc {
+extern uint temp_averaging_intervals;
+
+// Smooths raw readings; averages update in O(1) whatever the window size, the
+// median in O(log window)
+class TempFilter {
+public:
+  virtual ~TempFilter() = default;
+
+  virtual Temp update(Temp temp) = 0;
+
+  static unique_ptr<TempFilter> make(const fc_pb::TempFilter &f);
+};
+
+class MovingAverageFilter : public TempFilter {
+public:
+  explicit MovingAverageFilter(size_t window_);
+
+  Temp update(Temp temp) override;
+
+private:
+  vector<Temp> ring;
+  size_t ring_i = 0, filled = 0;
+  long sum = 0;
+};
+
+class EwmaFilter : public TempFilter {
+public:
+  explicit EwmaFilter(double alpha_);
+
+  Temp update(Temp temp) override;
+
+private:
+  const double alpha;
+  optional<double> avg;
+};
+
+class MedianFilter : public TempFilter {
+public:
+  explicit MedianFilter(size_t window_);
+
+  Temp update(Temp temp) override;
+
+private:
+  const size_t window;
+  std::deque<Temp> order;
+  std::multiset<Temp> sorted;
+  std::multiset<Temp>::iterator mid; // At sorted.size() / 2
+};
+
+class KalmanFilter : public TempFilter {
+public:
+  KalmanFilter(double process_noise_, double measurement_noise_);
+
+  Temp update(Temp temp) override;
+
+private:
+  const double process_noise, measurement_noise;
+  optional<double> estimate;
+  double error = 1;
+};
+} // namespace fc
+
+#endif // FANCON_TEMPFILTER_HPP
@@ -0,0 +1,200 @@
+#include "ThermalEvents.hpp"
+
+namespace {
+const char *THERMAL_FAMILY = "thermal", *THERMAL_EVENT_GROUP = "event";
+
+template <typename F> void for_each_attr(const nlattr *a, int len, F f) {
+  for (; len >= NLA_HDRLEN && a->nla_len >= NLA_HDRLEN && a->nla_len <= len;
+       len -= NLA_ALIGN(a->nla_len),
+       a = reinterpret_cast<const nlattr *>(
+           reinterpret_cast<const char *>(a) + NLA_ALIGN(a->nla_len)))
+    f(a);
+}
+
+const char *attr_data(const nlattr *a) {
+  return reinterpret_cast<const char *>(a) + NLA_HDRLEN;
+}
+} // namespace
+
+namespace fc {
+mutex ThermalEvents::wake_mutex;
+std::condition_variable ThermalEvents::wake_cv;
+uint64_t ThermalEvents::generation = 0;
+std::atomic_bool ThermalEvents::has_sources = false;
+} // namespace fc
+
+fc::ThermalEvents::ThermalEvents(const std::set<path> &hwmon_dirs)
+    : stop_fd(eventfd(0, EFD_CLOEXEC)) {
+  if (!subscribe_netlink())
+    LOG(llvl::debug) << "Thermal netlink events unavailable";
+
+  open_alarms(hwmon_dirs);
+  LOG(llvl::debug) << "Listening for thermal events on " << alarm_fds.size()
+                   << " alarms" << ((genl_fd >= 0) ? " & netlink" : "");
+
+  has_sources = genl_fd >= 0 || !alarm_fds.empty();
+  listener = std::thread([this] { listen(); });
+}
+
+fc::ThermalEvents::~ThermalEvents() {
+  has_sources = false;
+  const uint64_t stop = 1;
+  if (write(stop_fd, &stop, sizeof(stop)) < 0)
+    LOG(llvl::error) << "Failed to stop thermal event listener";
+
+  if (listener.joinable())
+    listener.join();
+
+  for (const int fd : alarm_fds)
+    close(fd);
+  if (genl_fd >= 0)
+    close(genl_fd);
+  close(stop_fd);
+}
+
+bool fc::ThermalEvents::wait_for(milliseconds duration) {
+  std::unique_lock lock(wake_mutex);
+  const uint64_t gen = generation;
+  return wake_cv.wait_for(lock, std::chrono::milliseconds(duration.count()),
+                          [&] { return generation != gen; });
+}
+
+bool fc::ThermalEvents::listening() { return has_sources; }
+
+bool fc::ThermalEvents::subscribe_netlink() {
+  genl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+  if (genl_fd < 0)
+    return false;
+
+  sockaddr_nl addr{};
+  addr.nl_family = AF_NETLINK;
+  if (bind(genl_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) {
+    if (const auto group = resolve_event_group(); group &&
+        setsockopt(genl_fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &*group,
+                   sizeof(*group)) == 0)
+      return true;
+  }
+
+  close(genl_fd);
+  genl_fd = -1;
+  return false;
+}
+
+optional<uint32_t> fc::ThermalEvents::resolve_event_group() {
+  // Ask the generic netlink controller for the thermal family's groups
+  struct {
+    nlmsghdr n;
+    genlmsghdr g;
+    char attrs[64];
+  } req{};
+  auto *na = reinterpret_cast<nlattr *>(req.attrs);
+  const size_t name_len = strlen(THERMAL_FAMILY) + 1;
+  na->nla_type = CTRL_ATTR_FAMILY_NAME;
+  na->nla_len = NLA_HDRLEN + name_len;
+  memcpy(req.attrs + NLA_HDRLEN, THERMAL_FAMILY, name_len);
+
+  req.n.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN) + NLA_ALIGN(na->nla_len);
+  req.n.nlmsg_type = GENL_ID_CTRL;
+  req.n.nlmsg_flags = NLM_F_REQUEST;
+  req.n.nlmsg_seq = 1;
+  req.g.cmd = CTRL_CMD_GETFAMILY;
+  req.g.version = 1;
+
+  if (send(genl_fd, &req, req.n.nlmsg_len, 0) < 0)
+    return nullopt;
+
+  alignas(nlmsghdr) char buf[8192];
+  const ssize_t len = recv(genl_fd, buf, sizeof(buf), 0);
+  const auto *n = reinterpret_cast<const nlmsghdr *>(buf);
+  if (len < 0 || !NLMSG_OK(n, len) || n->nlmsg_type == NLMSG_ERROR)
+    return nullopt; // Family isn't registered, e.g. CONFIG_THERMAL_NETLINK=n
+
+  optional<uint32_t> group;
+  const auto *attrs = reinterpret_cast<const nlattr *>(
+      static_cast<const char *>(NLMSG_DATA(n)) + GENL_HDRLEN);
+  const int attrs_len = n->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+  for_each_attr(attrs, attrs_len, [&](const nlattr *a) {
+    if ((a->nla_type & NLA_TYPE_MASK) != CTRL_ATTR_MCAST_GROUPS)
+      return;
+
+    // Nested list of groups, each with a name & id
+    const auto *groups = reinterpret_cast<const nlattr *>(attr_data(a));
+    for_each_attr(groups, a->nla_len - NLA_HDRLEN, [&](const nlattr *g) {
+      const char *name = nullptr;
+      optional<uint32_t> id;
+      const auto *gattrs = reinterpret_cast<const nlattr *>(attr_data(g));
+      for_each_attr(gattrs, g->nla_len - NLA_HDRLEN, [&](const nlattr *ga) {
+        if (ga->nla_type == CTRL_ATTR_MCAST_GRP_NAME)
+          name = attr_data(ga);
+        else if (ga->nla_type == CTRL_ATTR_MCAST_GRP_ID)
+          id = *reinterpret_cast<const uint32_t *>(attr_data(ga));
+      });
+
+      if (name && id && strcmp(name, THERMAL_EVENT_GROUP) == 0)
+        group = id;
+    });
+  });
+
+  return group;
+}
+
+void fc::ThermalEvents::open_alarms(const std::set<path> &hwmon_dirs) {
+  for (const auto &dir : hwmon_dirs) {
+    std::error_code ec;
+    for (const auto &e : fs::directory_iterator(dir, ec)) {
+      const string name = e.path().filename().string();
+      if (!name.starts_with("temp") || !name.ends_with("_alarm"))
+        continue;
+
+      // Must be read once before sysfs will notify of changes
+      const int fd = open(e.path().c_str(), O_RDONLY | O_CLOEXEC);
+      char v;
+      if (fd >= 0 && pread(fd, &v, sizeof(v), 0) > 0)
+        alarm_fds.push_back(fd);
+      else if (fd >= 0)
+        close(fd);
+    }
+  }
+}
+
+void fc::ThermalEvents::listen() {
+  vector<pollfd> fds{{stop_fd, POLLIN, 0}};
+  if (genl_fd >= 0)
+    fds.push_back({genl_fd, POLLIN, 0});
+  for (const int fd : alarm_fds)
+    fds.push_back({fd, POLLPRI | POLLERR, 0});
+
+  alignas(nlmsghdr) char buf[8192];
+  while (poll(fds.data(), fds.size(), -1) >= 0 || errno == EINTR) {
+    if (fds[0].revents != 0)
+      return;
+
+    bool woken = false;
+    for (auto it = next(fds.begin()); it != fds.end(); ++it) {
+      if (it->revents == 0)
+        continue;
+
+      if (it->fd == genl_fd) {
+        woken |= recv(genl_fd, buf, sizeof(buf), MSG_DONTWAIT) > 0;
+      } else {
+        // Re-reading re-arms the notification; only wake on a raised alarm
+        char v = '0';
+        woken |= pread(it->fd, &v, sizeof(v), 0) > 0 && v != '0';
+      }
+    }
+
+    if (woken)
+      wake();
+  }
+
+  LOG(llvl::error) << "Thermal event listener failed: " << strerror(errno);
+}
+
+void fc::ThermalEvents::wake() {
+  LOG(llvl::trace) << "Thermal event" << fc::log::flush;
+  {
+    const lock_guard<mutex> lg(wake_mutex);
+    ++generation;
+  }
+  wake_cv.notify_all();
+}
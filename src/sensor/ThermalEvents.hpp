@@ -0,0 +1,45 @@
+#ifndef FANCON_THERMALEVENTS_HPP
+#define FANCON_THERMALEVENTS_HPP
+
+#include <condition_variable>
+#include <fcntl.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+
+#include "util/Util.hpp"
+
+namespace fc {
+// Wakes waiting control loops on kernel thermal netlink events (e.g. trip
+// point crossings) & hwmon alarms
+// https://www.kernel.org/doc/Documentation/hwmon/sysfs-interface
+class ThermalEvents {
+public:
+  explicit ThermalEvents(const std::set<path> &hwmon_dirs);
+  ~ThermalEvents();
+
+  static bool wait_for(milliseconds duration);
+  static bool listening();
+
+private:
+  int genl_fd = -1, stop_fd = -1;
+  vector<int> alarm_fds;
+  std::thread listener;
+
+  static mutex wake_mutex;
+  static std::condition_variable wake_cv;
+  static uint64_t generation;
+  static std::atomic_bool has_sources;
+
+  bool subscribe_netlink();
+  optional<uint32_t> resolve_event_group();
+  void open_alarms(const std::set<path> &hwmon_dirs);
+  void listen();
+  static void wake();
+};
+} // namespace fc
+
+#endif // FANCON_THERMALEVENTS_HPP
@@ -11,7 +11,8 @@ using fc::Util::is_root;
 
 namespace fc {
 static const char *DEFAULT_CONF_PATH(FANCON_SYSCONFDIR "/fancon.conf"),
-    *DEFAULT_SYSINFO_PATH = "sysinfo.txt";
+    *DEFAULT_SYSINFO_PATH = "sysinfo.txt",
+    *DEFAULT_PROFILES_PATH = "fancon-profiles.txt";
 
 class Arg {
 public:
@@ -31,18 +32,25 @@ public:
       enable = {"enable", "e", true, false},
       disable = {"disable", "d", true, false},
       test = {"test", "t", true, false}, force = {"force", "f"},
+      cancel = {"cancel", "x", true, false},
       monitor = {"monitor", "m", true, false}, reload = {"reload", "r"},
+      profile = {"profile", "p", true, false},
+      latency = {"latency", "l", true, false},
       config = {"config", "c", true, true, DEFAULT_CONF_PATH, true},
       service = {"service"}, daemon = {"daemon"},
       stop_service = {"stop-service"},
       sysinfo = {"sysinfo", "i", true, true, DEFAULT_SYSINFO_PATH},
+      export_profiles = {"export-profiles", "", true, true, DEFAULT_PROFILES_PATH},
+      import_profiles = {"import-profiles", "", true, true, DEFAULT_PROFILES_PATH},
       recover = {"recover"}, nv_init = {"nv-init"}, verbose = {"verbose", "v"},
       trace = {"trace", "a"};
 
   map<string, Arg &> from_key = {
       a(help),    a(status),       a(enable),  a(disable), a(test),
-      a(force),   a(monitor),      a(reload),  a(config),  a(service),
+      a(force),   a(monitor),      a(reload),  a(profile), a(config),
+      a(latency), a(cancel),   a(service),
       a(daemon),  a(stop_service), a(sysinfo), a(recover), a(nv_init),
+      a(export_profiles), a(import_profiles),
       a(verbose), a(trace)};
 
   map<string, string> short_to_key() const;
@@ -0,0 +1,90 @@
+#include "Executor.hpp"
+
+namespace {
+// Eagerly started root of a coroutine chain, freeing itself on completion
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+Detached run(fc::Task<> task, std::promise<void> done) {
+  // Start on the pool rather than the spawning thread
+  co_await fc::Executor::sleep(milliseconds(0));
+  try {
+    co_await task;
+  } catch (const std::exception &e) {
+    LOG(llvl::error) << "Task failed: " << e.what();
+  }
+  done.set_value();
+}
+} // namespace
+
+namespace fc {
+Executor::Pool Executor::pool;
+} // namespace fc
+
+fc::Executor::Sleep fc::Executor::sleep(milliseconds duration) {
+  return Sleep{duration};
+}
+
+std::shared_future<void> fc::Executor::spawn(Task<> task) {
+  std::promise<void> done;
+  auto future = done.get_future().share();
+  run(move(task), move(done));
+  return future;
+}
+
+bool fc::Executor::Timer::operator>(const Timer &other) const {
+  return (deadline != other.deadline) ? deadline > other.deadline
+                                      : seq > other.seq;
+}
+
+fc::Executor::Pool::~Pool() {
+  {
+    const lock_guard<mutex> lg(timers_mutex);
+    stop = true;
+  }
+  timers_cv.notify_all();
+  for (auto &t : workers)
+    t.join();
+}
+
+void fc::Executor::schedule(std::coroutine_handle<> h, milliseconds delay) {
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(delay.count());
+  {
+    const lock_guard<mutex> lg(pool.timers_mutex);
+    // Workers are only started once something needs them
+    while (pool.workers.size() < EXECUTOR_THREADS)
+      pool.workers.emplace_back(work);
+
+    pool.timers.push({deadline, pool.seq++, h});
+  }
+  pool.timers_cv.notify_one();
+}
+
+void fc::Executor::work() {
+  std::unique_lock lock(pool.timers_mutex);
+  while (!pool.stop) {
+    if (pool.timers.empty()) {
+      pool.timers_cv.wait(lock);
+      continue;
+    }
+
+    const Timer next = pool.timers.top();
+    if (next.deadline > std::chrono::steady_clock::now()) {
+      pool.timers_cv.wait_until(lock, next.deadline);
+      continue;
+    }
+
+    pool.timers.pop();
+    lock.unlock();
+    next.h.resume();
+    lock.lock();
+  }
+}
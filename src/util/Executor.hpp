@@ -0,0 +1,150 @@
+#ifndef FANCON_EXECUTOR_HPP
+#define FANCON_EXECUTOR_HPP
+
+#include <condition_variable>
+#include <coroutine>
+#include <future>
+#include <queue>
+#include <thread>
+
+#include "util/Util.hpp"
+
+namespace fc {
+const uint EXECUTOR_THREADS = 2;
+
+template <class T = void> class Task;
+
+struct TaskPromiseBase {
+  std::coroutine_handle<> continuation;
+  std::exception_ptr error;
+
+  // Resume whoever is awaiting the task once it finishes
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <class P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+      const auto c = h.promise().continuation;
+      return c ? c : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+template <class T> struct TaskPromise : TaskPromiseBase {
+  optional<T> value;
+
+  Task<T> get_return_object() noexcept;
+  void return_value(T v) { value = std::move(v); }
+  T result();
+};
+
+template <> struct TaskPromise<void> : TaskPromiseBase {
+  Task<void> get_return_object() noexcept;
+  void return_void() const noexcept {}
+  void result();
+};
+
+// Lazily started coroutine, run by co_await'ing it from another coroutine
+// or by spawning it on the Executor
+template <class T> class Task {
+public:
+  using promise_type = TaskPromise<T>;
+  using handle = std::coroutine_handle<promise_type>;
+
+  explicit Task(handle h_) : h(h_) {}
+  Task(Task &&other) noexcept : h(std::exchange(other.h, nullptr)) {}
+  Task(const Task &) = delete;
+  ~Task();
+
+  bool await_ready() const noexcept { return !h || h.done(); }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) noexcept;
+  T await_resume() { return h.promise().result(); }
+
+private:
+  handle h;
+};
+
+// Runs coroutines on a small shared pool, suspending them on timers rather
+// than blocking a thread each
+class Executor {
+public:
+  struct Sleep {
+    milliseconds duration;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) const { schedule(h, duration); }
+    void await_resume() const noexcept {}
+  };
+
+  static Sleep sleep(milliseconds duration);
+  static std::shared_future<void> spawn(Task<> task);
+
+private:
+  using time_point = std::chrono::steady_clock::time_point;
+
+  struct Timer {
+    time_point deadline;
+    uint64_t seq; // Keeps FIFO order for equal deadlines
+    std::coroutine_handle<> h;
+
+    bool operator>(const Timer &other) const;
+  };
+
+  struct Pool {
+    ~Pool();
+
+    mutex timers_mutex;
+    std::condition_variable timers_cv;
+    std::priority_queue<Timer, vector<Timer>, std::greater<>> timers;
+    uint64_t seq = 0;
+    bool stop = false;
+    vector<std::thread> workers;
+  };
+
+  static Pool pool;
+
+  static void schedule(std::coroutine_handle<> h, milliseconds delay);
+  static void work();
+};
+} // namespace fc
+
+//----------------------//
+// TEMPLATE DEFINITIONS //
+//----------------------//
+
+template <class T> fc::Task<T> fc::TaskPromise<T>::get_return_object() noexcept {
+  return Task<T>(Task<T>::handle::from_promise(*this));
+}
+
+template <class T> T fc::TaskPromise<T>::result() {
+  if (error)
+    std::rethrow_exception(error);
+  return std::move(*value);
+}
+
+inline fc::Task<void> fc::TaskPromise<void>::get_return_object() noexcept {
+  return Task<void>(Task<void>::handle::from_promise(*this));
+}
+
+inline void fc::TaskPromise<void>::result() {
+  if (error)
+    std::rethrow_exception(error);
+}
+
+template <class T> fc::Task<T>::~Task() {
+  if (h)
+    h.destroy();
+}
+
+template <class T>
+std::coroutine_handle<> fc::Task<T>::await_suspend(std::coroutine_handle<> c) noexcept {
+  // Start the task, symmetrically transferring back to c when it finishes
+  h.promise().continuation = c;
+  return h;
+}
+
+#endif // FANCON_EXECUTOR_HPP
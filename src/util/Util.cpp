@@ -1,4 +1,8 @@
 #include "Util.hpp"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <google/protobuf/util/field_mask_util.h>
 
 optional<string> fc::Util::read_line(const path &p, bool failed) {
   std::ifstream ifs(p.string());
@@ -44,10 +48,55 @@ std::chrono::high_resolution_clock::time_point fc::Util::deadline(long ms) {
   return std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(ms);
 }
 
+long fc::Util::monotonic_ns() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1'000'000'000L + t.tv_nsec;
+}
+
+long fc::Util::sleep_until(long monotonic_deadline_ns) {
+  const timespec t{monotonic_deadline_ns / 1'000'000'000L, monotonic_deadline_ns % 1'000'000'000L};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, nullptr) == EINTR) {
+  }
+
+  // How late the wakeup was
+  return std::max(0L, monotonic_ns() - monotonic_deadline_ns);
+}
+
+bool fc::Util::set_realtime(uint priority, uint cpu) {
+  // Applies to the calling thread only
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  const sched_param param{int(priority)};
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0 &&
+         pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+void fc::Util::prefault_stack() {
+  // Touch the stack up front so locked pages don't fault mid tick
+  constexpr size_t size = 64 * 1024;
+  char stack[size];
+  for (size_t i = 0; i < size; i += 4096)
+    stack[i] = 0;
+  asm volatile("" : : "r"(stack) : "memory");
+}
+
 bool fc::Util::deep_equal(const google::protobuf::Message &m1, const google::protobuf::Message &m2) {
   return m1.ByteSizeLong() == m2.ByteSizeLong() && m1.SerializeAsString() == m2.SerializeAsString();
 }
 
+void fc::Util::merge(const google::protobuf::Message &src, const google::protobuf::FieldMask &mask,
+                     google::protobuf::Message &dst) {
+  using google::protobuf::util::FieldMaskUtil;
+
+  // Empty mask; merge all fields set in src
+  if (mask.paths().empty())
+    dst.MergeFrom(src);
+  else
+    FieldMaskUtil::MergeMessageTo(src, mask, FieldMaskUtil::MergeOptions(), &dst);
+}
+
 optional<path> fc::Util::real_path(path p) {
   p = absolute(p);
   char buf[PATH_MAX];
@@ -57,6 +106,85 @@ optional<path> fc::Util::real_path(path p) {
   return path(buf);
 }
 
+bool fc::Util::write_atomic(const path &p, const string &contents) {
+  // Write & sync a temp file, then rename it over p; a crash leaves either
+  // the old or the new file, never a partial one. The temp file is unique,
+  // so concurrent writers can't interleave into it
+  string tmp = p.string() + ".XXXXXX";
+  const int fd = mkostemp(tmp.data(), O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  fchmod(fd, 0644);
+
+  bool ok = true;
+  for (size_t written = 0; ok && written < contents.size();) {
+    const ssize_t n = ::write(fd, contents.data() + written, contents.size() - written);
+    ok = n > 0 || (n < 0 && errno == EINTR);
+    written += std::max<ssize_t>(n, 0);
+  }
+  ok = fsync(fd) == 0 && ok;
+  ok = close(fd) == 0 && ok;
+
+  if (!ok || rename(tmp.c_str(), p.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+
+  // Persist the rename itself
+  const path dir = p.has_parent_path() ? p.parent_path() : path(".");
+  if (const int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  return true;
+}
+
+vector<string> fc::Util::list_dir(int dir_fd) {
+  // Each getdents64 call returns a buffer-full of entries, rather than one per readdir
+  vector<string> names;
+  alignas(dirent64) char buf[8192];
+  for (long n; (n = syscall(SYS_getdents64, dir_fd, buf, sizeof(buf))) > 0;) {
+    for (long off = 0; off < n;) {
+      const auto *d = reinterpret_cast<const dirent64 *>(buf + off);
+      off += d->d_reclen;
+
+      const string_view name(d->d_name);
+      if (name != "." && name != "..")
+        names.emplace_back(name);
+    }
+  }
+  return names;
+}
+
+optional<string> fc::Util::read_line_at(int dir_fd, const string &name) {
+  const int fd = openat(dir_fd, name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return nullopt;
+
+  char buf[256];
+  const ssize_t n = ::read(fd, buf, sizeof(buf));
+  close(fd);
+  if (n < 0)
+    return nullopt;
+
+  const string_view contents(buf, n);
+  return string(contents.substr(0, contents.find('\n')));
+}
+
+optional<path> fc::Util::DirEntries::get(const string &name) const {
+  return (names.contains(name)) ? optional(dir / name) : nullopt;
+}
+
+string fc::Util::dmi_id() {
+  // Identifies the board model (not the unit, unlike serials & UUIDs)
+  const path dmi_dir("/sys/class/dmi/id");
+  string id;
+  for (const char *attr : {"board_vendor", "board_name", "product_name"})
+    id += read_line(dmi_dir / attr).value_or("") + "/";
+  return id;
+}
+
 fc::Util::ScopedCounter<atomic_int> fc::Util::RemovableMutex::acquire_lock() {
   while (counter < 0)
     sleep_for(milliseconds(50));
@@ -19,8 +19,13 @@
 //#include <chrono>
 #include <boost/chrono.hpp>
 #include <boost/thread.hpp>
+#include <google/protobuf/field_mask.pb.h>
 #include <google/protobuf/message.h>
+#include <ctime>
+#include <fcntl.h>
+#include <sched.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "Logging.hpp"
@@ -77,8 +82,26 @@ string join(std::initializer_list<pair<bool, string>> args, string join_with = "
 bool is_root();
 bool is_atty();
 std::chrono::high_resolution_clock::time_point deadline(long ms);
+long monotonic_ns();
+long sleep_until(long monotonic_deadline_ns);
+bool set_realtime(uint priority, uint cpu);
+void prefault_stack();
 bool deep_equal(const google::protobuf::Message &m1, const google::protobuf::Message &m2);
+void merge(const google::protobuf::Message &src, const google::protobuf::FieldMask &mask,
+           google::protobuf::Message &dst);
 optional<path> real_path(path p);
+string dmi_id();
+bool write_atomic(const path &p, const string &contents);
+vector<string> list_dir(int dir_fd);
+optional<string> read_line_at(int dir_fd, const string &name);
+
+// A directory's entries, listed once so attributes can be looked up without a stat each
+struct DirEntries {
+  path dir;
+  std::set<string> names;
+
+  optional<path> get(const string &name) const;
+};
 
 template<class T> class ObservableNumber {
 public:
@@ -0,0 +1,128 @@
+#include "Zone.hpp"
+
+Percent fc::Zone::get_percent() {
+  // Evaluated once per sensor reading, whichever member ticks first; the
+  // others share the result, however their ticks are phased
+  const lock_guard<mutex> lg(eval_mutex);
+  if (!sensor) // Removed on reload
+    return last_percent;
+
+  const Temp temp = sensor->get_average_temp();
+  if (!dirty && sensor->get_version() == sensor_version)
+    return last_percent;
+
+  dirty = false;
+  sensor_version = sensor->get_version();
+  if (const Percent p = std::min(interpolate(*curve, temp), Percent(100));
+      p != last_percent) {
+    last_percent = p;
+    ++version;
+  }
+
+  LOG(llvl::trace) << *this << ": " << last_percent << "%" << fc::log::flush;
+
+  return last_percent;
+}
+
+shared_ptr<fc::Sensor> fc::Zone::get_sensor() const {
+  // Copied, as a reload may re-link it
+  const lock_guard<mutex> lg(eval_mutex);
+  return sensor;
+}
+
+bool fc::Zone::is_configured() const {
+  return sensor && !sensor->ignore && !curve->empty();
+}
+
+void fc::Zone::compile_profiles(const vector<fc_pb::Profile> &profs) {
+  map<string, Temp_to_Percent_Map> compiled;
+  for (const auto &p : profs) {
+    if (const auto it = p.temp_to_rpm().find(label);
+        it != p.temp_to_rpm().end())
+      temp_to_percent_from(it->second, compiled[p.name()]);
+  }
+
+  const lock_guard<mutex> lg(eval_mutex);
+  curve = &temp_to_percent;
+  profiles = move(compiled);
+  dirty = true;
+}
+
+void fc::Zone::use_profile(const string &name) {
+  const lock_guard<mutex> lg(eval_mutex);
+  const auto it = profiles.find(name);
+  curve = (it != profiles.end()) ? &it->second : &temp_to_percent;
+  dirty = true;
+}
+
+void fc::Zone::link(const SensorMap &sensor_map) {
+  // The live sensor, so it's read & filtered once per tick for fans & zones
+  const auto s_it = sensor_map.find(sensor_label);
+  auto s = (s_it != sensor_map.end()) ? s_it->second : nullptr;
+
+  const lock_guard<mutex> lg(eval_mutex);
+  if (s != sensor) {
+    sensor = move(s);
+    dirty = true;
+  }
+}
+
+void fc::Zone::from(const fc_pb::Zone &z, const SensorMap &sensor_map) {
+  label = z.label();
+  sensor_label = z.sensor();
+  const auto s_it = sensor_map.find(sensor_label);
+  sensor = (s_it != sensor_map.end()) ? s_it->second : nullptr;
+
+  temp_to_percent.clear();
+  temp_to_percent_from(z.temp_to_percent(), temp_to_percent);
+  fans.assign(z.fan().begin(), z.fan().end());
+  dirty = true;
+}
+
+void fc::Zone::to(fc_pb::Zone &z) const {
+  z.set_label(label);
+  z.set_sensor(sensor ? sensor->label : sensor_label);
+
+  // Written as percentages, e.g. "40: 0%, 80: 100%"
+  std::stringstream ss;
+  for (auto it = temp_to_percent.begin(); it != temp_to_percent.end();) {
+    ss << it->first << ": " << it->second << "%";
+    if (++it != temp_to_percent.end())
+      ss << ", ";
+  }
+  z.set_temp_to_percent(ss.str());
+
+  for (const auto &flabel : fans)
+    z.add_fan(flabel);
+}
+
+void fc::Zone::temp_to_percent_from(const string &src,
+                                    Temp_to_Percent_Map &dst) const {
+  string::const_iterator start_it = src.begin(), next_it = src.end();
+  std::smatch m;
+  const auto next_item = [&] {
+    // The next value starts after the match ends
+    next_it = m[0].second;
+    start_it = (next_it != src.end()) ? next(next_it) : next_it;
+  };
+
+  // 1: temp, 2: is_fahrenheit, 3: percent
+  for (const regex reg(R"((\d+)\s*([fF])?[cC]?\s*[:]\s*(\d+)\s*%?)");
+       std::regex_search(start_it, next_it, m, reg); next_item()) {
+    auto temp = Util::from_string<Temp>(m[1]);
+    const auto percent = Util::from_string<Percent>(m[3]);
+    if (!temp || !percent) {
+      LOG(llvl::error) << *this << ": invalid temp_to_percent item: " << m[0];
+      continue;
+    }
+
+    if (m[2].matched)
+      *temp = (5.0 / 9.0) * (*temp - 32.0);
+
+    dst[*temp] = std::min(*percent, Percent(100));
+  }
+}
+
+std::ostream &fc::operator<<(std::ostream &os, const fc::Zone &z) {
+  return os << z.label;
+}
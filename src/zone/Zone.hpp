@@ -0,0 +1,55 @@
+#ifndef FANCON_ZONE_HPP
+#define FANCON_ZONE_HPP
+
+#include "fan/Fan.hpp"
+#include "sensor/Sensor.hpp"
+#include "util/Util.hpp"
+#include "proto/DevicesSpec.pb.h"
+
+using Temp_to_Percent_Map = std::map<Temp, Percent>;
+
+namespace fc {
+// Fans sharing one sensor & curve; the curve is evaluated once per change of
+// the sensor's temperature
+class Zone {
+public:
+  Zone() = default;
+
+  string label;
+  vector<string> fans;
+
+  Percent get_percent();
+  shared_ptr<fc::Sensor> get_sensor() const;
+  uint64_t get_version() const { return version; }
+  bool is_configured() const;
+  void compile_profiles(const vector<fc_pb::Profile> &profiles);
+  void use_profile(const string &name);
+  void link(const SensorMap &sensor_map);
+
+  void from(const fc_pb::Zone &z, const SensorMap &sensor_map);
+  void to(fc_pb::Zone &z) const;
+
+  friend std::ostream &operator<<(std::ostream &os, const Zone &z);
+
+private:
+  string sensor_label;
+  shared_ptr<fc::Sensor> sensor;
+  Temp_to_Percent_Map temp_to_percent;
+  map<string, Temp_to_Percent_Map> profiles;
+  const Temp_to_Percent_Map *curve = &temp_to_percent;
+
+  mutable mutex eval_mutex;
+  Percent last_percent = 0;
+  uint64_t sensor_version = 0;
+  bool dirty = true;
+  std::atomic<uint64_t> version{0}; // Bumped when the percent changes
+
+  void temp_to_percent_from(const string &src, Temp_to_Percent_Map &dst) const;
+};
+
+std::ostream &operator<<(std::ostream &os, const Zone &z);
+} // namespace fc
+
+using ZoneMap = std::unordered_map<string, shared_ptr<fc::Zone>>;
+
+#endif // FANCON_ZONE_HPP